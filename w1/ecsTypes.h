@@ -1,4 +1,5 @@
 #pragma once
+#include <cfloat>
 
 struct Position;
 struct MovePos;
@@ -111,3 +112,11 @@ struct Team
 
 struct TextureSource {};
 
+
+// Gathered once per turn, FSM transitions and states read it instead of scanning the world
+struct Perception
+{
+  float hitpoints = 0.f;
+  float closestEnemyDist = FLT_MAX;
+  Position closestEnemyPos;
+};
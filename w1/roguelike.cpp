@@ -3,11 +3,14 @@
 #include "raylib.h"
 #include "stateMachine.h"
 #include "aiLibrary.h"
+#include <cmath>
 
-static void add_patrol_attack_flee_sm(flecs::entity entity)
+// machines are built once and shared by every monster using them
+static const StateMachineDef &patrol_attack_flee_sm()
 {
-  entity.get([](StateMachine &sm)
+  static const StateMachineDef def = []()
   {
+    StateMachineDef sm;
     int patrol = sm.addState(create_patrol_state(3.f));
     int moveToEnemy = sm.addState(create_move_to_enemy_state());
     int fleeFromEnemy = sm.addState(create_flee_from_enemy_state());
@@ -21,27 +24,50 @@ static void add_patrol_attack_flee_sm(flecs::entity entity)
                      patrol, fleeFromEnemy);
 
     sm.addTransition(create_negate_transition(create_enemy_available_transition(7.f)), fleeFromEnemy, patrol);
-  });
+    return sm;
+  }();
+  return def;
 }
 
-static void add_patrol_flee_sm(flecs::entity entity)
+static const StateMachineDef &patrol_flee_sm()
 {
-  entity.get([](StateMachine &sm)
+  static const StateMachineDef def = []()
   {
+    StateMachineDef sm;
     int patrol = sm.addState(create_patrol_state(3.f));
     int fleeFromEnemy = sm.addState(create_flee_from_enemy_state());
 
     sm.addTransition(create_enemy_available_transition(3.f), patrol, fleeFromEnemy);
     sm.addTransition(create_negate_transition(create_enemy_available_transition(5.f)), fleeFromEnemy, patrol);
-  });
+    return sm;
+  }();
+  return def;
 }
 
-static void add_attack_sm(flecs::entity entity)
+static const StateMachineDef &attack_sm()
 {
-  entity.get([](StateMachine &sm)
+  static const StateMachineDef def = []()
   {
+    StateMachineDef sm;
     sm.addState(create_move_to_enemy_state());
-  });
+    return sm;
+  }();
+  return def;
+}
+
+static void add_patrol_attack_flee_sm(flecs::entity entity)
+{
+  entity.set(StateMachine{&patrol_attack_flee_sm()});
+}
+
+static void add_patrol_flee_sm(flecs::entity entity)
+{
+  entity.set(StateMachine{&patrol_flee_sm()});
+}
+
+static void add_attack_sm(flecs::entity entity)
+{
+  entity.set(StateMachine{&attack_sm()});
 }
 
 static flecs::entity create_monster(flecs::world &ecs, int x, int y, Color color)
@@ -54,6 +80,7 @@ static flecs::entity create_monster(flecs::world &ecs, int x, int y, Color color
     .set(Action{EA_NOP})
     .set(Color{color})
     .set(StateMachine{})
+    .set(Perception{})
     .set(Team{1})
     .set(NumActions{1, 0})
     .set(MeleeDamage{20.f});
@@ -256,20 +283,42 @@ static void process_actions(flecs::world &ecs)
   });
 }
 
+// sensors: closest enemy is found once per turn for every agent and shared by all transitions
+static void gather_perception(flecs::world &ecs)
+{
+  static auto perceptionQuery = ecs.query<Perception, const Position, const Hitpoints, const Team>();
+  static auto othersQuery = ecs.query<const Position, const Team>();
+  perceptionQuery.each([&](Perception &perception, const Position &pos, const Hitpoints &hp, const Team &team)
+  {
+    perception.hitpoints = hp.hitpoints;
+    perception.closestEnemyDist = FLT_MAX;
+    othersQuery.each([&](const Position &opos, const Team &oteam)
+    {
+      if (team.team == oteam.team)
+        return;
+      const float dx = float(opos.x - pos.x);
+      const float dy = float(opos.y - pos.y);
+      const float curDist = sqrtf(dx * dx + dy * dy);
+      if (curDist < perception.closestEnemyDist)
+      {
+        perception.closestEnemyDist = curDist;
+        perception.closestEnemyPos = opos;
+      }
+    });
+  });
+}
+
 void process_turn(flecs::world &ecs)
 {
-  static auto stateMachineAct = ecs.query<StateMachine>();
   if (is_player_acted(ecs))
   {
     if (upd_player_actions_count(ecs))
     {
       // Plan action for NPCs
+      gather_perception(ecs);
       ecs.defer([&]
       {
-        stateMachineAct.each([&](flecs::entity e, StateMachine &sm)
-        {
-          sm.act(0.f, ecs, e);
-        });
+        act_state_machines(ecs, 0.f);
       });
     }
     process_actions(ecs);
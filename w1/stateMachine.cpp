@@ -1,44 +1,87 @@
 #include "stateMachine.h"
+#include <algorithm>
 
-StateMachine::~StateMachine()
+StateMachineDef::~StateMachineDef()
 {
-  for (State* state : states)
+  for (const State* state : states)
     delete state;
   states.clear();
-  for (auto &transList : transitions)
-    for (auto &transition : transList)
-      delete transition.first;
+  for (const Transition &transition : transitions)
+    delete transition.transition;
   transitions.clear();
 }
 
-void StateMachine::act(float dt, flecs::world &ecs, flecs::entity entity)
+int StateMachineDef::addState(State *st)
 {
-  if (curStateIdx < states.size())
-  {
-    for (const std::pair<StateTransition*, int> &transition : transitions[curStateIdx])
-      if (transition.first->isAvailable(ecs, entity))
-      {
-        states[curStateIdx]->exit();
-        curStateIdx = transition.second;
-        states[curStateIdx]->enter();
-        break;
-      }
-    states[curStateIdx]->act(dt, ecs, entity);
-  }
-  else
-    curStateIdx = 0;
-}
-
-int StateMachine::addState(State *st)
-{
-  int idx = states.size();
+  int idx = int(states.size());
   states.push_back(st);
-  transitions.push_back(std::vector<std::pair<StateTransition*, int>>());
+  firstTransition.push_back(firstTransition.back());
   return idx;
 }
 
-void StateMachine::addTransition(StateTransition *trans, int from, int to)
+void StateMachineDef::addTransition(StateTransition *trans, int from, int to)
 {
-  transitions[from].push_back(std::make_pair(trans, to));
+  // keep table grouped by source state, it's only done when machine is built
+  const uint32_t at = firstTransition[size_t(from) + 1];
+  transitions.insert(transitions.begin() + at, Transition{trans, to});
+  for (size_t i = size_t(from) + 1; i < firstTransition.size(); ++i)
+    firstTransition[i]++;
 }
 
+void act_state_machines(flecs::world &ecs, float dt)
+{
+  static auto stateMachineQuery = ecs.query<StateMachine, const Perception>();
+
+  struct Agent
+  {
+    flecs::entity entity;
+    StateMachine *sm;
+    const Perception *perception;
+    int nextState;
+  };
+  static std::vector<Agent> agents;
+  agents.clear();
+  stateMachineQuery.each([&](flecs::entity e, StateMachine &sm, const Perception &perception)
+  {
+    if (!sm.def || sm.def->numStates() == 0)
+      return;
+    if (size_t(sm.curStateIdx) >= sm.def->numStates())
+      sm.curStateIdx = 0;
+    agents.push_back({e, &sm, &perception, -1});
+  });
+  std::sort(agents.begin(), agents.end(), [](const Agent &lhs, const Agent &rhs)
+  {
+    if (lhs.sm->def != rhs.sm->def)
+      return lhs.sm->def < rhs.sm->def;
+    return lhs.sm->curStateIdx < rhs.sm->curStateIdx;
+  });
+
+  for (size_t groupBegin = 0; groupBegin < agents.size();)
+  {
+    const StateMachineDef *def = agents[groupBegin].sm->def;
+    const int state = agents[groupBegin].sm->curStateIdx;
+    size_t groupEnd = groupBegin + 1;
+    while (groupEnd < agents.size() && agents[groupEnd].sm->def == def && agents[groupEnd].sm->curStateIdx == state)
+      ++groupEnd;
+    // first available transition wins, so check them in order for everyone still undecided
+    for (const StateMachineDef::Transition *tr = def->transitionsBegin(state); tr != def->transitionsEnd(state); ++tr)
+      for (size_t i = groupBegin; i < groupEnd; ++i)
+        if (agents[i].nextState < 0 && tr->transition->isAvailable(*agents[i].perception))
+          agents[i].nextState = tr->to;
+    groupBegin = groupEnd;
+  }
+
+  for (Agent &agent : agents)
+  {
+    StateMachine &sm = *agent.sm;
+    if (agent.nextState >= 0)
+    {
+      sm.def->getState(sm.curStateIdx)->exit();
+      sm.curStateIdx = agent.nextState;
+      sm.stateTime = 0.f;
+      sm.def->getState(sm.curStateIdx)->enter();
+    }
+    sm.stateTime += dt;
+    sm.def->getState(sm.curStateIdx)->act(dt, ecs, agent.entity);
+  }
+}
@@ -1,10 +1,13 @@
 #pragma once
 #include <vector>
+#include <cstdint>
 #include <flecs.h>
+#include "ecsTypes.h"
 
 class State
 {
 public:
+  virtual ~State() {}
   virtual void enter() const = 0;
   virtual void exit() const = 0;
   virtual void act(float dt, flecs::world &ecs, flecs::entity entity) const = 0;
@@ -14,28 +17,50 @@ class StateTransition
 {
 public:
   virtual ~StateTransition() {}
-  virtual bool isAvailable(flecs::world &ecs, flecs::entity entity) const = 0;
+  // pure predicate over cached perception, no world queries here
+  virtual bool isAvailable(const Perception &perception) const = 0;
 };
 
-class StateMachine
+// Immutable once built, shared by all entities using the same machine.
+// Transitions of all states are stored in one table, grouped by source state.
+class StateMachineDef
 {
-  int curStateIdx = 0;
-  std::vector<State*> states;
-  std::vector<std::vector<std::pair<StateTransition*, int>>> transitions;
 public:
-  StateMachine() = default;
-  StateMachine(const StateMachine &sm) = default;
-  StateMachine(StateMachine &&sm) = default;
-
-  ~StateMachine();
-
-  StateMachine &operator=(const StateMachine &sm) = default;
-  StateMachine &operator=(StateMachine &&sm) = default;
+  struct Transition
+  {
+    const StateTransition *transition;
+    int to;
+  };
+private:
+  std::vector<const State*> states;
+  std::vector<Transition> transitions;
+  std::vector<uint32_t> firstTransition = {0}; // per state, last one is the table end
+public:
+  StateMachineDef() = default;
+  StateMachineDef(const StateMachineDef &sm) = delete;
+  StateMachineDef(StateMachineDef &&sm) = default;
 
+  ~StateMachineDef();
 
-  void act(float dt, flecs::world &ecs, flecs::entity entity);
+  StateMachineDef &operator=(const StateMachineDef &sm) = delete;
+  StateMachineDef &operator=(StateMachineDef &&sm) = default;
 
   int addState(State *st);
   void addTransition(StateTransition *trans, int from, int to);
+
+  size_t numStates() const { return states.size(); }
+  const State *getState(int idx) const { return states[size_t(idx)]; }
+  const Transition *transitionsBegin(int from) const { return transitions.data() + firstTransition[size_t(from)]; }
+  const Transition *transitionsEnd(int from) const { return transitions.data() + firstTransition[size_t(from) + 1]; }
+};
+
+// Per entity state of the machine, definition is shared
+struct StateMachine
+{
+  const StateMachineDef *def = nullptr;
+  int curStateIdx = 0;
+  float stateTime = 0.f;
 };
 
+// Steps all state machines, entities in the same state are evaluated together
+void act_state_machines(flecs::world &ecs, float dt);
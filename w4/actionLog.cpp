@@ -0,0 +1,46 @@
+#include "actionLog.h"
+#include <cstdarg>
+#include <cstdio>
+
+static FILE *event_stream = nullptr;
+
+void ActionLog::push(int turn, ActionLogEvent event, float amount, const char *msg, ...)
+{
+  char *slot = messages[head];
+  const int prefixLen = snprintf(slot, action_log_msg_size, "%d: ", turn);
+  if (prefixLen >= 0 && size_t(prefixLen) < action_log_msg_size)
+  {
+    va_list args;
+    va_start(args, msg);
+    vsnprintf(slot + prefixLen, action_log_msg_size - size_t(prefixLen), msg, args);
+    va_end(args);
+  }
+  head = (head + 1) % action_log_capacity;
+  if (count < action_log_capacity)
+    count++;
+
+  if (event_stream)
+  {
+    const action_log::EventRecord record{turn, uint8_t(event), {0, 0, 0}, amount};
+    fwrite(&record, sizeof(record), 1, event_stream);
+  }
+}
+
+const char *ActionLog::get(size_t i) const
+{
+  return messages[(head + action_log_capacity - count + i) % action_log_capacity];
+}
+
+bool action_log::open_event_stream(const char *path)
+{
+  close_event_stream();
+  event_stream = fopen(path, "wb");
+  return event_stream != nullptr;
+}
+
+void action_log::close_event_stream()
+{
+  if (event_stream)
+    fclose(event_stream);
+  event_stream = nullptr;
+}
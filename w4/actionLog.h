@@ -0,0 +1,49 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+enum ActionLogEvent : uint8_t
+{
+  ALE_HEAL = 0,
+  ALE_DAMAGE,
+  ALE_DEATH,
+  ALE_NUM
+};
+
+#if defined(__GNUC__)
+#define ACTION_LOG_PRINTF(fmt_idx, args_idx) __attribute__((format(printf, fmt_idx, args_idx)))
+#else
+#define ACTION_LOG_PRINTF(fmt_idx, args_idx)
+#endif
+
+constexpr size_t action_log_capacity = 5;
+constexpr size_t action_log_msg_size = 64;
+
+// Last messages in a ring of fixed size buffers, pushing never allocates.
+struct ActionLog
+{
+  char messages[action_log_capacity][action_log_msg_size] = {};
+  size_t head = 0; // slot for the next message
+  size_t count = 0;
+
+  // msg is printf style format, turn is prepended
+  // implicit this is the first argument for the format check
+  void push(int turn, ActionLogEvent event, float amount, const char *msg, ...) ACTION_LOG_PRINTF(5, 6);
+  // i-th message starting from the oldest one
+  const char *get(size_t i) const;
+};
+
+// Optional binary stream of every pushed event for offline analysis, one fixed size record each.
+namespace action_log
+{
+  struct EventRecord
+  {
+    int32_t turn;
+    uint8_t event;
+    uint8_t pad[3];
+    float amount;
+  };
+
+  bool open_event_stream(const char *path);
+  void close_event_stream();
+};
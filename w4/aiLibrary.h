@@ -1,8 +1,8 @@
 #pragma once
 
-#include <functional>
 #include "stateMachine.h"
 #include "behaviourTree.h"
+#include "utilityScoring.h"
 
 // states
 State *create_attack_enemy_state();
@@ -18,14 +18,14 @@ StateTransition *create_hitpoints_less_than_transition(float thres);
 StateTransition *create_negate_transition(StateTransition *in);
 StateTransition *create_and_transition(StateTransition *lhs, StateTransition *rhs);
 
-using utility_function = std::function<float(Blackboard&)>;
-
 BehNode *sequence(const std::vector<BehNode*> &nodes);
 BehNode *selector(const std::vector<BehNode*> &nodes);
-BehNode *utility_selector(const std::vector<std::pair<BehNode*, utility_function>> &nodes);
+BehNode *utility_selector(flecs::entity entity, const std::vector<std::pair<BehNode*, utility_function>> &nodes);
+// utilities are looked up by name among curves loaded with load_utility_curves
+BehNode *utility_selector(flecs::entity entity, const std::vector<std::pair<BehNode*, const char*>> &nodes);
 
 BehNode *move_to_entity(flecs::entity entity, const char *bb_name);
-BehNode *is_low_hp(float thres);
+BehNode *is_low_hp(flecs::entity entity, float thres);
 BehNode *find_enemy(flecs::entity entity, float dist, const char *bb_name);
 BehNode *flee(flecs::entity entity, const char *bb_name);
 BehNode *patrol(flecs::entity entity, float patrol_dist, const char *bb_name);
@@ -4,11 +4,18 @@
 #include "math.h"
 #include "raylib.h"
 #include "blackboard.h"
+#include "utilityScoring.h"
 #include <algorithm>
+#include <cassert>
+#include <cstdio>
 
 struct CompoundNode : public BehNode
 {
+  static constexpr size_t no_child = size_t(-1);
+
   std::vector<BehNode*> nodes;
+  // child which returned BEH_RUNNING last time, we resume from it
+  size_t runningIdx = no_child;
 
   virtual ~CompoundNode()
   {
@@ -22,61 +29,143 @@ struct CompoundNode : public BehNode
     nodes.push_back(node);
     return *this;
   }
+
+  void abort() override
+  {
+    if (runningIdx < nodes.size())
+      nodes[runningIdx]->abort();
+    runningIdx = no_child;
+  }
+
+  // first child (before the running one) whose observed data has changed
+  size_t firstDirtyBefore(const Blackboard &bb, size_t idx) const
+  {
+    for (size_t i = 0; i < idx; ++i)
+      if (nodes[i]->needsReevaluation(bb))
+        return i;
+    return idx;
+  }
 };
 
 struct Sequence : public CompoundNode
 {
+  // index of the child at which previous evaluation has stopped
+  size_t lastIdx = 0;
+
   BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
   {
-    for (BehNode *node : nodes)
+    // resume from the running child, unless some preceding condition is invalidated
+    size_t from = runningIdx < nodes.size() ? firstDirtyBefore(bb, runningIdx) : 0;
+    for (size_t i = from; i < nodes.size(); ++i)
     {
-      BehResult res = node->update(ecs, entity, bb);
-      if (res != BEH_SUCCESS)
-        return res;
+      BehResult res = nodes[i]->tick(ecs, entity, bb);
+      if (res == BEH_SUCCESS)
+        continue;
+      if (runningIdx < nodes.size() && runningIdx != i)
+        nodes[runningIdx]->abort();
+      runningIdx = res == BEH_RUNNING ? i : no_child;
+      lastIdx = i;
+      return res;
     }
+    runningIdx = no_child;
+    lastIdx = nodes.empty() ? 0 : nodes.size() - 1;
     return BEH_SUCCESS;
   }
+
+  bool needsReevaluation(const Blackboard &bb) const override
+  {
+    if (nodes.empty())
+      return false;
+    return firstDirtyBefore(bb, std::min(lastIdx + 1, nodes.size())) <= lastIdx;
+  }
 };
 
 struct Selector : public CompoundNode
 {
   BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
   {
-    for (BehNode *node : nodes)
+    // higher priority children are re-evaluated only if data they observe has changed
+    size_t from = runningIdx < nodes.size() ? firstDirtyBefore(bb, runningIdx) : 0;
+    for (size_t i = from; i < nodes.size(); ++i)
     {
-      BehResult res = node->update(ecs, entity, bb);
-      if (res != BEH_FAIL)
-        return res;
+      BehResult res = nodes[i]->tick(ecs, entity, bb);
+      if (res == BEH_FAIL)
+        continue;
+      if (runningIdx < nodes.size() && runningIdx != i)
+        nodes[runningIdx]->abort();
+      runningIdx = res == BEH_RUNNING ? i : no_child;
+      return res;
     }
+    runningIdx = no_child;
     return BEH_FAIL;
   }
+
+  bool needsReevaluation(const Blackboard &bb) const override
+  {
+    for (const BehNode *node : nodes)
+      if (node->needsReevaluation(bb))
+        return true;
+    return false;
+  }
 };
 
 struct UtilitySelector : public BehNode
 {
-  std::vector<std::pair<BehNode*, utility_function>> utilityNodes;
+  std::vector<BehNode*> utilityNodes;
+  size_t runningIdx = size_t(-1);
 
-  BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
+  UtilitySelector(flecs::entity entity, const std::vector<std::pair<BehNode*, UtilityScorer>> &nodes)
   {
-    std::vector<std::pair<float, size_t>> utilityScores;
-    for (size_t i = 0; i < utilityNodes.size(); ++i)
+    std::vector<UtilityScorer> scorers;
+    for (const std::pair<BehNode*, UtilityScorer> &node : nodes)
     {
-      const float utilityScore = utilityNodes[i].second(bb);
-      utilityScores.push_back(std::make_pair(utilityScore, i));
+      utilityNodes.push_back(node.first);
+      scorers.push_back(node.second);
     }
-    std::sort(utilityScores.begin(), utilityScores.end(), [](auto &lhs, auto &rhs)
-    {
-      return lhs.first > rhs.first;
-    });
-    for (const std::pair<float, size_t> &node : utilityScores)
+    entity.set(UtilityScores{register_utility_layout(scorers), 0, 0, {}});
+  }
+
+  BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
+  {
+    // scores are precomputed for all agents by score_utility_agents
+    UtilityScores us;
+    if (!entity.get([&](const UtilityScores &scores) { us = scores; }) || us.numScores == 0)
+      return BEH_FAIL;
+    const size_t numNodes = us.numScores;
+    uint32_t triedMask = 0u;
+    size_t nodeIdx = us.bestIdx;
+    for (size_t tries = 0; tries < numNodes; ++tries)
     {
-      size_t nodeIdx = node.second;
-      BehResult res = utilityNodes[nodeIdx].first->update(ecs, entity, bb);
-      if (res != BEH_FAIL)
-        return res;
+      // fall back to the next best of the children not tried yet only on failure
+      if (tries > 0)
+      {
+        nodeIdx = numNodes;
+        for (size_t i = 0; i < numNodes; ++i)
+          if ((triedMask & (1u << i)) == 0u && (nodeIdx == numNodes || us.scores[i] > us.scores[nodeIdx]))
+            nodeIdx = i;
+      }
+      triedMask |= 1u << nodeIdx;
+      BehResult res = utilityNodes[nodeIdx]->tick(ecs, entity, bb);
+      if (res == BEH_FAIL)
+        continue;
+      if (runningIdx < numNodes && runningIdx != nodeIdx)
+        utilityNodes[runningIdx]->abort();
+      runningIdx = res == BEH_RUNNING ? nodeIdx : size_t(-1);
+      return res;
     }
+    runningIdx = size_t(-1);
     return BEH_FAIL;
   }
+
+  void abort() override
+  {
+    if (runningIdx < utilityNodes.size())
+      utilityNodes[runningIdx]->abort();
+    runningIdx = size_t(-1);
+  }
+
+  // scores are recomputed every update anyway
+  bool needsReevaluation(const Blackboard &) const override { return true; }
 };
 
 struct MoveToEntity : public BehNode
@@ -116,7 +205,10 @@ struct MoveToEntity : public BehNode
 struct IsLowHp : public BehNode
 {
   float threshold = 0.f;
-  IsLowHp(float thres) : threshold(thres) {}
+  IsLowHp(flecs::entity entity, float thres) : threshold(thres)
+  {
+    watch(reg_entity_blackboard_var<float>(entity, "hp"));
+  }
 
   BehResult update(flecs::world &, flecs::entity entity, Blackboard &) override
   {
@@ -136,31 +228,16 @@ struct FindEnemy : public BehNode
   FindEnemy(flecs::entity entity, float in_dist, const char *bb_name) : distance(in_dist)
   {
     entityBb = reg_entity_blackboard_var<flecs::entity>(entity, bb_name);
+    watch(reg_entity_blackboard_var<float>(entity, "enemyDist"));
   }
   BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) override
   {
     BehResult res = BEH_FAIL;
-    static auto enemiesQuery = ecs.query<const Position, const Team>();
-    entity.set([&](const Position &pos, const Team &t)
+    entity.get([&](const Perception &p)
     {
-      flecs::entity closestEnemy;
-      float closestDist = FLT_MAX;
-      Position closestPos;
-      enemiesQuery.each([&](flecs::entity enemy, const Position &epos, const Team &et)
-      {
-        if (t.team == et.team)
-          return;
-        float curDist = dist(epos, pos);
-        if (curDist < closestDist)
-        {
-          closestDist = curDist;
-          closestPos = epos;
-          closestEnemy = enemy;
-        }
-      });
-      if (ecs.is_valid(closestEnemy) && closestDist <= distance)
+      if (p.numEnemies > 0 && ecs.is_valid(p.enemies[0]) && p.enemyDist[0] <= distance)
       {
-        bb.set<flecs::entity>(entityBb, closestEnemy);
+        bb.set<flecs::entity>(entityBb, p.enemies[0]);
         res = BEH_SUCCESS;
       }
     });
@@ -262,11 +339,26 @@ BehNode *selector(const std::vector<BehNode*> &nodes)
   return sel;
 }
 
-BehNode *utility_selector(const std::vector<std::pair<BehNode*, utility_function>> &nodes)
+BehNode *utility_selector(flecs::entity entity, const std::vector<std::pair<BehNode*, utility_function>> &nodes)
 {
-  UtilitySelector *usel = new UtilitySelector;
-  usel->utilityNodes = std::move(nodes);
-  return usel;
+  std::vector<std::pair<BehNode*, UtilityScorer>> scoredNodes;
+  for (const std::pair<BehNode*, utility_function> &node : nodes)
+    scoredNodes.emplace_back(node.first, UtilityScorer{node.second, nullptr});
+  return new UtilitySelector(entity, scoredNodes);
+}
+
+BehNode *utility_selector(flecs::entity entity, const std::vector<std::pair<BehNode*, const char*>> &nodes)
+{
+  std::vector<std::pair<BehNode*, UtilityScorer>> scoredNodes;
+  for (const std::pair<BehNode*, const char*> &node : nodes)
+  {
+    const CurveUtility *curves = find_curve_utility(node.second);
+    if (!curves)
+      printf("utility '%s' isn't loaded, it will always score 0\n", node.second);
+    assert(curves);
+    scoredNodes.emplace_back(node.first, UtilityScorer{nullptr, curves});
+  }
+  return new UtilitySelector(entity, scoredNodes);
 }
 
 BehNode *move_to_entity(flecs::entity entity, const char *bb_name)
@@ -274,9 +366,9 @@ BehNode *move_to_entity(flecs::entity entity, const char *bb_name)
   return new MoveToEntity(entity, bb_name);
 }
 
-BehNode *is_low_hp(float thres)
+BehNode *is_low_hp(flecs::entity entity, float thres)
 {
-  return new IsLowHp(thres);
+  return new IsLowHp(entity, thres);
 }
 
 BehNode *find_enemy(flecs::entity entity, float dist, const char *bb_name)
@@ -2,6 +2,7 @@
 
 #include <flecs.h>
 #include <memory>
+#include <vector>
 #include "blackboard.h"
 
 enum BehResult
@@ -13,8 +14,38 @@ enum BehResult
 
 struct BehNode
 {
+  // blackboard values this node's result depends on
+  std::vector<BlackboardWatch> watches;
+  // blackboard revision at the moment of the last update
+  uint32_t evalRevision = 0u;
+
   virtual ~BehNode() {}
   virtual BehResult update(flecs::world &ecs, flecs::entity entity, Blackboard &bb) = 0;
+
+  // called when running branch is interrupted by a higher priority one
+  virtual void abort() {}
+
+  // should we re-evaluate this node even though it had been decided before?
+  // leaves without watches (actions) never trigger re-evaluation themselves
+  virtual bool needsReevaluation(const Blackboard &bb) const
+  {
+    for (const BlackboardWatch &watch : watches)
+      if (watch.isDirty(bb, evalRevision))
+        return true;
+    return false;
+  }
+
+  BehResult tick(flecs::world &ecs, flecs::entity entity, Blackboard &bb)
+  {
+    BehResult res = update(ecs, entity, bb);
+    evalRevision = bb.getRevision();
+    return res;
+  }
+
+  void watch(size_t bb_idx)
+  {
+    watches.push_back(BlackboardWatch{bb_idx});
+  }
 };
 
 struct BehaviourTree
@@ -34,7 +65,6 @@ struct BehaviourTree
 
   void update(flecs::world &ecs, flecs::entity entity, Blackboard &bb)
   {
-    root->update(ecs, entity, bb);
+    root->tick(ecs, entity, bb);
   }
 };
-
@@ -3,69 +3,158 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 #include <flecs.h>
 #include "ecsTypes.h"
 
+// Every blackboard name is interned once into an integer key, keys are unique across types
+inline uint32_t &blackboard_keys_count()
+{
+  static uint32_t count = 0;
+  return count;
+}
+
 template<typename DataType>
-class NamedDataPool
+uint32_t intern_blackboard_key(const std::string &name)
 {
-public:
-  size_t regName(const std::string &name)
-  {
-    const auto itf = nameIndices.find(name);
-    if (itf != nameIndices.end())
-      return itf->second;
+  static std::unordered_map<std::string, uint32_t> keys;
+  const auto itf = keys.find(name);
+  if (itf != keys.end())
+    return itf->second;
+  const uint32_t key = blackboard_keys_count()++;
+  keys.emplace(name, key);
+  return key;
+}
 
-    size_t idx = data.size();
-    nameIndices.emplace(name, idx);
-    data.emplace_back(DataType());
-    return idx;
-  }
+template<typename DataType>
+struct BlackboardKey
+{
+  uint32_t id;
 
-  void set(size_t idx, const DataType &in_data)
-  {
-    data[idx] = in_data;
-  }
+  explicit BlackboardKey(const char *name) : id(intern_blackboard_key<DataType>(name)) {}
+};
 
-  DataType get(size_t idx) const
+// Layout of the blackboard shared between all entities of the same archetype.
+// Each value occupies a slot of whole words: first word holds change revision, the rest is the value.
+struct BlackboardSchema
+{
+  static constexpr uint32_t no_slot = uint32_t(-1);
+
+  std::vector<uint32_t> keyOffsets; // indexed by interned key
+  size_t numWords = 0;
+
+  template<typename DataType>
+  size_t slotOf(uint32_t key)
   {
-    return data[idx];
+    if (key >= keyOffsets.size())
+      keyOffsets.resize(key + 1, no_slot);
+    if (keyOffsets[key] == no_slot)
+    {
+      keyOffsets[key] = uint32_t(numWords);
+      numWords += 1 + (sizeof(DataType) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    }
+    return keyOffsets[key];
   }
-private:
-  std::unordered_map<std::string, size_t> nameIndices;
-  std::vector<DataType> data;
 };
 
-class Blackboard : public NamedDataPool<float>,
-                   public NamedDataPool<int>,
-                   public NamedDataPool<flecs::entity>,
-                   public NamedDataPool<Position>
+inline BlackboardSchema *get_blackboard_schema(const std::string &archetype)
 {
+  static std::unordered_map<std::string, std::unique_ptr<BlackboardSchema>> schemas;
+  std::unique_ptr<BlackboardSchema> &schema = schemas[archetype];
+  if (!schema)
+    schema = std::make_unique<BlackboardSchema>();
+  return schema.get();
+}
+
+class Blackboard
+{
+  BlackboardSchema *schema = nullptr;
+  std::vector<uint64_t> storage;
+  uint32_t revision = 0u;
+
+  template<typename DataType>
+  size_t regSlot(uint32_t key)
+  {
+    static_assert(std::is_trivially_copyable_v<DataType>, "blackboard stores raw values only");
+    const size_t idx = schema->slotOf<DataType>(key);
+    if (storage.size() < schema->numWords)
+      storage.resize(schema->numWords, 0u);
+    return idx;
+  }
 public:
+  Blackboard() : schema(get_blackboard_schema("default")) {}
+  explicit Blackboard(const char *archetype) : schema(get_blackboard_schema(archetype)) {}
+
   template<typename DataType>
   size_t regName(const std::string &name)
   {
-    return NamedDataPool<DataType>::regName(name);
+    return regSlot<DataType>(intern_blackboard_key<DataType>(name));
+  }
+
+  template<typename DataType>
+  size_t regName(BlackboardKey<DataType> key)
+  {
+    return regSlot<DataType>(key.id);
   }
 
   template<typename DataType>
   void set(size_t idx, const DataType &in_data)
   {
-    NamedDataPool<DataType>::set(idx, in_data);
+    uint64_t &rev = storage[idx];
+    if (rev != 0u && memcmp(&storage[idx + 1], &in_data, sizeof(DataType)) == 0)
+      return;
+    memcpy(&storage[idx + 1], &in_data, sizeof(DataType));
+    rev = ++revision;
+  }
+
+  template<typename DataType>
+  void set(BlackboardKey<DataType> key, const DataType &in_data)
+  {
+    set(regName(key), in_data);
   }
 
   template<typename DataType>
   DataType get(size_t idx) const
   {
-    return NamedDataPool<DataType>::get(idx);
+    DataType res;
+    memcpy(static_cast<void*>(&res), &storage[idx + 1], sizeof(DataType));
+    return res;
   }
 
-  // not perf optimized
+  template<typename DataType>
+  DataType get(BlackboardKey<DataType> key)
+  {
+    return get<DataType>(regName(key));
+  }
+
+  // not perf optimized, prefer BlackboardKey
   template<typename DataType>
   DataType get(const char *name)
   {
-    size_t idx = regName<DataType>(name);
-    return NamedDataPool<DataType>::get(idx);
+    return get<DataType>(regName<DataType>(name));
+  }
+
+  // revision of the last change of the value, 0 means that nobody has written it yet
+  uint32_t changedAt(size_t idx) const
+  {
+    return uint32_t(storage[idx]);
   }
+
+  uint32_t getRevision() const { return revision; }
 };
 
+// Reference to a blackboard value which behaviour node depends on
+struct BlackboardWatch
+{
+  size_t idx = size_t(-1);
+
+  // value was changed after given revision or no sensor writes it at all
+  bool isDirty(const Blackboard &bb, uint32_t since) const
+  {
+    const uint32_t rev = bb.changedAt(idx);
+    return rev == 0u || rev > since;
+  }
+};
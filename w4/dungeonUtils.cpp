@@ -1,37 +1,44 @@
 #include "dungeonUtils.h"
 #include "raylib.h"
 
-Position dungeon::find_walkable_tile(flecs::world &ecs)
+FloorTiles dungeon::build_floor_tiles(const DungeonData &dd)
 {
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  FloorTiles res;
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+      if (dd.tiles[y * dd.width + x] == dungeon::floor)
+        res.tiles.push_back(Position{int(x), int(y)});
+  return res;
+}
 
-  Position res{0, 0};
-  dungeonDataQuery.each([&](const DungeonData &dd)
-  {
-    // prebuild all walkable and get one of them
-    std::vector<Position> posList;
-    for (size_t y = 0; y < dd.height; ++y)
-      for (size_t x = 0; x < dd.width; ++x)
-        if (dd.tiles[y * dd.width + x] == dungeon::floor)
-          posList.push_back(Position{int(x), int(y)});
-    size_t rndIdx = size_t(GetRandomValue(0, int(posList.size()) - 1));
-    res = posList[rndIdx];
-  });
+DungeonWalkability dungeon::build_walkability(const DungeonData &dd)
+{
+  DungeonWalkability res;
+  res.width = dd.width;
+  res.height = dd.height;
+  res.stride = dd.width + 2;
+  res.walkable.assign(res.stride * (dd.height + 2), 0);
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+      res.walkable[(y + 1) * res.stride + x + 1] = dd.tiles[y * dd.width + x] == dungeon::floor;
   return res;
 }
 
-bool dungeon::is_tile_walkable(flecs::world &ecs, Position pos)
+Position dungeon::random_floor_tile(const FloorTiles &ft)
 {
-  static auto dungeonDataQuery = ecs.query<const DungeonData>();
+  if (ft.tiles.empty())
+    return Position{0, 0};
+  return ft.tiles[size_t(GetRandomValue(0, int(ft.tiles.size()) - 1))];
+}
+
+Position dungeon::find_walkable_tile(flecs::world &ecs)
+{
+  static auto floorTilesQuery = ecs.query<const FloorTiles>();
 
-  bool res = false;
-  dungeonDataQuery.each([&](const DungeonData &dd)
+  Position res{0, 0};
+  floorTilesQuery.each([&](const FloorTiles &ft)
   {
-    if (pos.x < 0 || pos.x >= int(dd.width) ||
-        pos.y < 0 || pos.y >= int(dd.height))
-      return;
-    res = dd.tiles[size_t(pos.y) * dd.width + size_t(pos.x)] == dungeon::floor;
+    res = random_floor_tile(ft);
   });
   return res;
 }
-
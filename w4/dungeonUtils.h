@@ -1,12 +1,37 @@
 #pragma once
 #include "ecsTypes.h"
 #include <flecs.h>
+#include <vector>
+#include <cstdint>
+
+// every floor tile of the dungeon, built together with DungeonData
+struct FloorTiles
+{
+  std::vector<Position> tiles;
+};
+
+// World singleton with walkability of every tile surrounded by a one tile wall border,
+// so anything at most one step outside of the map can be tested without bounds checks.
+struct DungeonWalkability
+{
+  std::vector<uint8_t> walkable;
+  size_t width = 0;
+  size_t height = 0;
+  size_t stride = 0;
+
+  bool isWalkable(Position pos) const
+  {
+    return walkable[size_t(pos.y + 1) * stride + size_t(pos.x + 1)] != 0;
+  }
+};
 
 namespace dungeon
 {
   constexpr char wall = '#';
   constexpr char floor = ' ';
 
+  FloorTiles build_floor_tiles(const DungeonData &dd);
+  DungeonWalkability build_walkability(const DungeonData &dd);
+  Position random_floor_tile(const FloorTiles &ft);
   Position find_walkable_tile(flecs::world &ecs);
-  bool is_tile_walkable(flecs::world &ecs, Position pos);
 };
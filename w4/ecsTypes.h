@@ -118,6 +118,9 @@ struct Symbol
 
 struct IsPlayer {};
 
+// marked entities are deleted in bulk at the end of the turn
+struct Dead {};
+
 struct WorldInfoGatherer {};
 
 struct Team
@@ -132,12 +135,6 @@ struct TurnCounter
   int count = 0;
 };
 
-struct ActionLog
-{
-  std::vector<std::string> log;
-  size_t capacity = 5;
-};
-
 struct BackgroundTile {};
 
 struct DungeonData
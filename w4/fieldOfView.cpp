@@ -0,0 +1,108 @@
+#include "fieldOfView.h"
+#include "dungeonUtils.h"
+
+static bool is_inside(const DungeonData &dd, int x, int y)
+{
+  return x >= 0 && y >= 0 && x < int(dd.width) && y < int(dd.height);
+}
+
+static bool is_opaque(const DungeonData &dd, int x, int y)
+{
+  return !is_inside(dd, x, y) || dd.tiles[size_t(y) * dd.width + size_t(x)] == dungeon::wall;
+}
+
+static void set_visible(const DungeonData &dd, std::vector<uint64_t> &bits, int x, int y)
+{
+  const size_t idx = size_t(y) * dd.width + size_t(x);
+  bits[idx / 64] |= 1ull << (idx % 64);
+}
+
+// one octant of recursive shadowcasting, xx..yy transform octant coords into map coords
+static void cast_light(const DungeonData &dd, std::vector<uint64_t> &bits, int cx, int cy,
+                       int row, float start, float end, int xx, int xy, int yx, int yy)
+{
+  if (start < end)
+    return;
+  float newStart = 0.f;
+  for (int j = row; j <= fov_radius; ++j)
+  {
+    int dx = -j - 1;
+    const int dy = -j;
+    bool blocked = false;
+    while (dx <= 0)
+    {
+      dx++;
+      const int x = cx + dx * xx + dy * xy;
+      const int y = cy + dx * yx + dy * yy;
+      const float leftSlope = (float(dx) - 0.5f) / (float(dy) + 0.5f);
+      const float rightSlope = (float(dx) + 0.5f) / (float(dy) - 0.5f);
+      if (start < rightSlope)
+        continue;
+      if (end > leftSlope)
+        break;
+      if (is_inside(dd, x, y) && dx * dx + dy * dy <= fov_radius * fov_radius)
+        set_visible(dd, bits, x, y);
+      if (blocked)
+      {
+        if (is_opaque(dd, x, y))
+        {
+          newStart = rightSlope;
+          continue;
+        }
+        blocked = false;
+        start = newStart;
+      }
+      else if (is_opaque(dd, x, y) && j < fov_radius)
+      {
+        blocked = true;
+        cast_light(dd, bits, cx, cy, j + 1, start, leftSlope, xx, xy, yx, yy);
+        newStart = rightSlope;
+      }
+    }
+    if (blocked)
+      break;
+  }
+}
+
+static void compute_fov(const DungeonData &dd, int cx, int cy, std::vector<uint64_t> &bits)
+{
+  constexpr int mult[4][8] =
+  {
+    {1, 0, 0, -1, -1, 0, 0, 1},
+    {0, 1, -1, 0, 0, -1, 1, 0},
+    {0, 1, 1, 0, 0, -1, -1, 0},
+    {1, 0, 0, 1, -1, 0, 0, -1}
+  };
+  bits.assign((dd.width * dd.height + 63) / 64, 0ull);
+  set_visible(dd, bits, cx, cy);
+  for (int oct = 0; oct < 8; ++oct)
+    cast_light(dd, bits, cx, cy, 1, 1.f, 0.f, mult[0][oct], mult[1][oct], mult[2][oct], mult[3][oct]);
+}
+
+FovCache create_fov_cache(const DungeonData &dd)
+{
+  FovCache res;
+  res.width = dd.width;
+  res.height = dd.height;
+  res.visible.resize(dd.width * dd.height);
+  return res;
+}
+
+bool FovCache::isVisible(const DungeonData &dd, Position from, Position to)
+{
+  if (width != dd.width || height != dd.height)
+    *this = create_fov_cache(dd);
+  if (!is_inside(dd, from.x, from.y) || !is_inside(dd, to.x, to.y))
+    return false;
+  std::vector<uint64_t> &bits = visible[size_t(from.y) * width + size_t(from.x)];
+  if (bits.empty())
+    compute_fov(dd, from.x, from.y, bits);
+  const size_t idx = size_t(to.y) * width + size_t(to.x);
+  return (bits[idx / 64] >> (idx % 64)) & 1ull;
+}
+
+void FovCache::invalidate()
+{
+  for (std::vector<uint64_t> &bits : visible)
+    bits.clear();
+}
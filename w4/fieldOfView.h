@@ -0,0 +1,21 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "ecsTypes.h"
+
+constexpr int fov_radius = 10;
+
+// Visible tiles from every tile, computed with recursive shadowcasting on first use and kept
+// until dungeon tiles change. Agents standing on the same tile share one result.
+struct FovCache
+{
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<std::vector<uint64_t>> visible; // per origin tile, empty until requested
+
+  bool isVisible(const DungeonData &dd, Position from, Position to);
+  // drop everything, call when tiles of the dungeon change
+  void invalidate();
+};
+
+FovCache create_fov_cache(const DungeonData &dd);
@@ -2,9 +2,12 @@
 #include "raylib.h"
 #include <flecs.h>
 #include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include "ecsTypes.h"
 #include "roguelike.h"
 #include "dungeonGen.h"
+#include "actionLog.h"
 
 static void update_camera(Camera2D &cam, flecs::world &ecs)
 {
@@ -17,8 +20,13 @@ static void update_camera(Camera2D &cam, flecs::world &ecs)
   });
 }
 
-int main(int /*argc*/, const char ** /*argv*/)
+int main(int argc, const char **argv)
 {
+  // -e <path> dumps every action log event into a binary file
+  for (int i = 1; i + 1 < argc; ++i)
+    if (strcmp(argv[i], "-e") == 0)
+      action_log::open_event_stream(argv[++i]);
+
   int width = 1920;
   int height = 1080;
   InitWindow(width, height, "w3 AI MIPT");
@@ -40,7 +48,13 @@ int main(int /*argc*/, const char ** /*argv*/)
     gen_drunk_dungeon(tiles, dungWidth, dungHeight);
     init_dungeon(ecs, tiles, dungWidth, dungHeight);
   }
-  init_roguelike(ecs);
+  if (!init_roguelike(ecs))
+  {
+    printf("failed to initialize roguelike\n");
+    CloseWindow();
+    action_log::close_event_stream();
+    return 1;
+  }
 
   Camera2D camera = { {0, 0}, {0, 0}, 0.f, 1.f };
   camera.target = Vector2{ 0.f, 0.f };
@@ -65,6 +79,7 @@ int main(int /*argc*/, const char ** /*argv*/)
   }
 
   CloseWindow();
+  action_log::close_event_stream();
 
   return 0;
 }
@@ -0,0 +1,100 @@
+#include "occupancyGrid.h"
+
+static bool is_inside(const OccupancyGrid &grid, int x, int y)
+{
+  return x >= 0 && y >= 0 && x < int(grid.width) && y < int(grid.height);
+}
+
+static size_t tile_idx(const OccupancyGrid &grid, int x, int y)
+{
+  return size_t(y) * grid.width + size_t(x);
+}
+
+OccupancyGrid create_occupancy_grid(size_t width, size_t height)
+{
+  OccupancyGrid res;
+  res.width = width;
+  res.height = height;
+  res.actors.resize(width * height);
+  res.pickups.resize(width * height);
+  return res;
+}
+
+flecs::entity OccupancyGrid::actorAt(int x, int y) const
+{
+  return is_inside(*this, x, y) ? actors[tile_idx(*this, x, y)] : flecs::entity();
+}
+
+flecs::entity OccupancyGrid::pickupAt(int x, int y) const
+{
+  return is_inside(*this, x, y) ? pickups[tile_idx(*this, x, y)] : flecs::entity();
+}
+
+void OccupancyGrid::setActor(int x, int y, flecs::entity e)
+{
+  if (is_inside(*this, x, y))
+    actors[tile_idx(*this, x, y)] = e;
+}
+
+void OccupancyGrid::setPickup(int x, int y, flecs::entity e)
+{
+  if (is_inside(*this, x, y))
+    pickups[tile_idx(*this, x, y)] = e;
+}
+
+void OccupancyGrid::clearActor(int x, int y, flecs::entity e)
+{
+  if (is_inside(*this, x, y) && actors[tile_idx(*this, x, y)] == e)
+    actors[tile_idx(*this, x, y)] = flecs::entity();
+}
+
+void OccupancyGrid::clearPickup(int x, int y, flecs::entity e)
+{
+  if (is_inside(*this, x, y) && pickups[tile_idx(*this, x, y)] == e)
+    pickups[tile_idx(*this, x, y)] = flecs::entity();
+}
+
+void OccupancyGrid::moveActor(int from_x, int from_y, int to_x, int to_y, flecs::entity e)
+{
+  clearActor(from_x, from_y, e);
+  setActor(to_x, to_y, e);
+}
+
+void register_occupancy_observers(flecs::world &ecs)
+{
+  static auto occupancyQuery = ecs.query<OccupancyGrid>();
+
+  ecs.observer<const MovePos, const Hitpoints>()
+    .event(flecs::OnSet)
+    .each([&](flecs::entity e, const MovePos &mpos, const Hitpoints &)
+    {
+      occupancyQuery.each([&](OccupancyGrid &grid) { grid.setActor(mpos.x, mpos.y, e); });
+    });
+  ecs.observer<const MovePos, const Hitpoints>()
+    .event(flecs::OnRemove)
+    .each([&](flecs::entity e, const MovePos &mpos, const Hitpoints &)
+    {
+      occupancyQuery.each([&](OccupancyGrid &grid) { grid.clearActor(mpos.x, mpos.y, e); });
+    });
+
+  auto add_pickup = [&](flecs::entity e, const Position &pos)
+  {
+    occupancyQuery.each([&](OccupancyGrid &grid) { grid.setPickup(pos.x, pos.y, e); });
+  };
+  auto remove_pickup = [&](flecs::entity e, const Position &pos)
+  {
+    occupancyQuery.each([&](OccupancyGrid &grid) { grid.clearPickup(pos.x, pos.y, e); });
+  };
+  ecs.observer<const Position, const HealAmount>()
+    .event(flecs::OnSet)
+    .each([=](flecs::entity e, const Position &pos, const HealAmount &) { add_pickup(e, pos); });
+  ecs.observer<const Position, const HealAmount>()
+    .event(flecs::OnRemove)
+    .each([=](flecs::entity e, const Position &pos, const HealAmount &) { remove_pickup(e, pos); });
+  ecs.observer<const Position, const PowerupAmount>()
+    .event(flecs::OnSet)
+    .each([=](flecs::entity e, const Position &pos, const PowerupAmount &) { add_pickup(e, pos); });
+  ecs.observer<const Position, const PowerupAmount>()
+    .event(flecs::OnRemove)
+    .each([=](flecs::entity e, const Position &pos, const PowerupAmount &) { remove_pickup(e, pos); });
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include "ecsTypes.h"
+
+// Tile to entity index. Actors (anything with hitpoints) are stored by their MovePos,
+// pickups by Position, there's at most one of each per tile.
+struct OccupancyGrid
+{
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<flecs::entity> actors;
+  std::vector<flecs::entity> pickups;
+
+  flecs::entity actorAt(int x, int y) const;
+  flecs::entity pickupAt(int x, int y) const;
+  void setActor(int x, int y, flecs::entity e);
+  void setPickup(int x, int y, flecs::entity e);
+  // clears the tile only if it's still taken by e
+  void clearActor(int x, int y, flecs::entity e);
+  void clearPickup(int x, int y, flecs::entity e);
+  void moveActor(int from_x, int from_y, int to_x, int to_y, flecs::entity e);
+};
+
+OccupancyGrid create_occupancy_grid(size_t width, size_t height);
+// keeps grid on the dungeon entity in sync when actors and pickups appear or disappear
+void register_occupancy_observers(flecs::world &ecs);
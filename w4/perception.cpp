@@ -0,0 +1,166 @@
+#include "perception.h"
+#include "math.h"
+#include "fieldOfView.h"
+#include <algorithm>
+#include <cfloat>
+
+constexpr int perception_cell_size = 4;
+
+namespace
+{
+  struct Member
+  {
+    flecs::entity entity;
+    Position pos;
+  };
+
+  // members of one team sorted by cell, cell i owns [cellStart[i], cellStart[i + 1])
+  struct TeamGrid
+  {
+    std::vector<Member> members;
+    std::vector<uint32_t> cellStart;
+    std::vector<Member> scratch;
+  };
+}
+
+static int cells_w = 0;
+static int cells_h = 0;
+static std::vector<TeamGrid> team_grids;
+
+static int cell_of(int v, int num_cells)
+{
+  return std::clamp(v / perception_cell_size, 0, num_cells - 1);
+}
+
+static size_t cell_idx(const Position &pos)
+{
+  return size_t(cell_of(pos.y, cells_h)) * size_t(cells_w) + size_t(cell_of(pos.x, cells_w));
+}
+
+static void build_grid(TeamGrid &grid)
+{
+  grid.cellStart.assign(size_t(cells_w * cells_h) + 2, 0u);
+  for (const Member &m : grid.members)
+    grid.cellStart[cell_idx(m.pos) + 2]++;
+  for (size_t i = 2; i < grid.cellStart.size(); ++i)
+    grid.cellStart[i] += grid.cellStart[i - 1];
+  grid.scratch.resize(grid.members.size());
+  for (const Member &m : grid.members)
+    grid.scratch[grid.cellStart[cell_idx(m.pos) + 1]++] = m;
+  grid.members.swap(grid.scratch);
+}
+
+template<typename Callable>
+static void for_each_in_cell(const TeamGrid &grid, int cx, int cy, Callable c)
+{
+  if (cx < 0 || cy < 0 || cx >= cells_w || cy >= cells_h)
+    return;
+  const size_t idx = size_t(cy) * size_t(cells_w) + size_t(cx);
+  for (uint32_t i = grid.cellStart[idx]; i < grid.cellStart[idx + 1]; ++i)
+    c(grid.members[i]);
+}
+
+static void insert_enemy(Perception &p, const Member &m, float d)
+{
+  size_t at = p.numEnemies;
+  // ties go to lower entity id, so result doesn't depend on iteration order
+  while (at > 0 && (d < p.enemyDist[at - 1] ||
+                    (d == p.enemyDist[at - 1] && m.entity.id() < p.enemies[at - 1].id())))
+    --at;
+  if (at >= perception_max_enemies)
+    return;
+  const size_t last = std::min(p.numEnemies, perception_max_enemies - 1);
+  for (size_t i = last; i > at; --i)
+  {
+    p.enemies[i] = p.enemies[i - 1];
+    p.enemyPos[i] = p.enemyPos[i - 1];
+    p.enemyDist[i] = p.enemyDist[i - 1];
+  }
+  p.enemies[at] = m.entity;
+  p.enemyPos[at] = m.pos;
+  p.enemyDist[at] = d;
+  p.numEnemies = std::min(p.numEnemies + 1, perception_max_enemies);
+}
+
+void gather_perception(flecs::world &ecs)
+{
+  static auto dungeonDataQuery = ecs.query<const DungeonData, FovCache>();
+  static auto teamMembersQuery = ecs.query<const Position, const Team>();
+  static auto perceptionQuery = ecs.query<Perception, const Position, const Team>();
+
+  const DungeonData *dungeon = nullptr;
+  FovCache *fov = nullptr;
+  dungeonDataQuery.each([&](const DungeonData &dd, FovCache &fc)
+  {
+    dungeon = &dd;
+    fov = &fc;
+    cells_w = int(dd.width + perception_cell_size - 1) / perception_cell_size;
+    cells_h = int(dd.height + perception_cell_size - 1) / perception_cell_size;
+  });
+  if (!dungeon || cells_w <= 0 || cells_h <= 0)
+    return;
+
+  for (TeamGrid &grid : team_grids)
+    grid.members.clear();
+  teamMembersQuery.each([&](flecs::entity e, const Position &pos, const Team &team)
+  {
+    if (team.team < 0)
+      return;
+    if (size_t(team.team) >= team_grids.size())
+      team_grids.resize(size_t(team.team) + 1);
+    team_grids[size_t(team.team)].members.push_back({e, pos});
+  });
+  for (TeamGrid &grid : team_grids)
+    build_grid(grid);
+
+  perceptionQuery.each([&](Perception &p, const Position &pos, const Team &team)
+  {
+    p = Perception{};
+    const int cx = cell_of(pos.x, cells_w);
+    const int cy = cell_of(pos.y, cells_h);
+
+    if (team.team >= 0 && size_t(team.team) < team_grids.size())
+    {
+      const TeamGrid &allies = team_grids[size_t(team.team)];
+      const int r = int(perception_allies_dist) / perception_cell_size + 1;
+      for (int y = cy - r; y <= cy + r; ++y)
+        for (int x = cx - r; x <= cx + r; ++x)
+          for_each_in_cell(allies, x, y, [&](const Member &m)
+          {
+            if (dist_sq(pos, m.pos) < sqr(perception_allies_dist))
+              p.alliesNum += 1.f;
+          });
+    }
+
+    // grow rings of cells until nothing closer than the k-th enemy can be left
+    // nothing further than fov radius can be seen
+    const int maxRing = std::min(std::max(cells_w, cells_h), fov_radius / perception_cell_size + 1);
+    for (int ring = 0; ring <= maxRing; ++ring)
+    {
+      for (size_t t = 0; t < team_grids.size(); ++t)
+      {
+        if (int(t) == team.team)
+          continue;
+        auto visit = [&](const Member &m)
+        {
+          if (fov->isVisible(*dungeon, pos, m.pos))
+            insert_enemy(p, m, dist(pos, m.pos));
+        };
+        for (int x = cx - ring; x <= cx + ring; ++x)
+        {
+          for_each_in_cell(team_grids[t], x, cy - ring, visit);
+          if (ring > 0)
+            for_each_in_cell(team_grids[t], x, cy + ring, visit);
+        }
+        for (int y = cy - ring + 1; y <= cy + ring - 1; ++y)
+        {
+          for_each_in_cell(team_grids[t], cx - ring, y, visit);
+          for_each_in_cell(team_grids[t], cx + ring, y, visit);
+        }
+      }
+      if (p.numEnemies == perception_max_enemies &&
+          p.enemyDist[perception_max_enemies - 1] < float(ring * perception_cell_size))
+        break;
+    }
+  });
+}
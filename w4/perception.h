@@ -0,0 +1,22 @@
+#pragma once
+#include <flecs.h>
+#include "ecsTypes.h"
+
+constexpr size_t perception_max_enemies = 4;
+constexpr float perception_allies_dist = 5.f;
+
+// What an agent knows about others this turn, filled once per turn by gather_perception.
+// Only enemies in field of view are perceived.
+struct Perception
+{
+  size_t numEnemies = 0; // closest first
+  flecs::entity enemies[perception_max_enemies];
+  Position enemyPos[perception_max_enemies];
+  float enemyDist[perception_max_enemies];
+  float alliesNum = 0.f; // within perception_allies_dist, agent itself included
+
+  float closestEnemyDist(float def) const { return numEnemies > 0 ? enemyDist[0] : def; }
+};
+
+// buckets everyone with a team into per team grids and fills Perception of every agent
+void gather_perception(flecs::world &ecs);
@@ -0,0 +1,77 @@
+#include "responseCurve.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define RESPONSE_CURVE_SSE 1
+#endif
+
+float ResponseCurve::shape(float x) const
+{
+  switch (type)
+  {
+    case CURVE_LINEAR:
+      return m * (x - c) + b;
+    case CURVE_QUADRATIC:
+      return m * (x - c) * (x - c) + b;
+    case CURVE_LOGISTIC:
+      return m / (1.f + expf(-k * (x - c))) + b;
+    case CURVE_PIECEWISE:
+    {
+      if (points.size() < 2)
+        return points.empty() ? 0.f : points[0];
+      const float t = x * float(points.size() - 1);
+      const size_t i = std::min(size_t(t), points.size() - 2);
+      return points[i] + (t - float(i)) * (points[i + 1] - points[i]);
+    }
+  }
+  return 0.f;
+}
+
+void ResponseCurve::bake()
+{
+  for (size_t i = 0; i <= lut_segments; ++i)
+    lut[i] = shape(float(i) / float(lut_segments));
+  lut[lut_segments + 1] = lut[lut_segments];
+}
+
+static float to_lut_coord(float input, float in_min, float in_max)
+{
+  const float x = (input - in_min) / (in_max - in_min);
+  return std::clamp(x, 0.f, 1.f) * float(ResponseCurve::lut_segments);
+}
+
+float ResponseCurve::evaluate(float input) const
+{
+  const float t = to_lut_coord(input, inMin, inMax);
+  const size_t i = size_t(t);
+  return lut[i] + (t - float(i)) * (lut[i + 1] - lut[i]);
+}
+
+void ResponseCurve::accumulate(const float *in, float *out, size_t count) const
+{
+  size_t i = 0;
+#if RESPONSE_CURVE_SSE
+  const __m128 offset = _mm_set1_ps(-inMin);
+  const __m128 scale = _mm_set1_ps(float(lut_segments) / (inMax - inMin));
+  const __m128 minT = _mm_setzero_ps();
+  const __m128 maxT = _mm_set1_ps(float(lut_segments));
+  alignas(16) int idx[4];
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(in + i), offset), scale);
+    t = _mm_min_ps(_mm_max_ps(t, minT), maxT);
+    const __m128i ti = _mm_cvttps_epi32(t);
+    const __m128 frac = _mm_sub_ps(t, _mm_cvtepi32_ps(ti));
+    _mm_store_si128(reinterpret_cast<__m128i*>(idx), ti);
+    // no gather in SSE2, only the table reads are scalar
+    const __m128 y0 = _mm_setr_ps(lut[idx[0]], lut[idx[1]], lut[idx[2]], lut[idx[3]]);
+    const __m128 y1 = _mm_setr_ps(lut[idx[0] + 1], lut[idx[1] + 1], lut[idx[2] + 1], lut[idx[3] + 1]);
+    const __m128 y = _mm_add_ps(y0, _mm_mul_ps(frac, _mm_sub_ps(y1, y0)));
+    _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), y));
+  }
+#endif
+  for (; i < count; ++i)
+    out[i] += evaluate(in[i]);
+}
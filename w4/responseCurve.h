@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+enum CurveType
+{
+  CURVE_LINEAR,
+  CURVE_QUADRATIC,
+  CURVE_LOGISTIC,
+  CURVE_PIECEWISE
+};
+
+// Maps input normalised to [0, 1] into utility.
+// Any curve is baked into a lookup table, so evaluation cost doesn't depend on its type.
+struct ResponseCurve
+{
+  static constexpr size_t lut_segments = 64;
+
+  CurveType type = CURVE_LINEAR;
+  float inMin = 0.f;
+  float inMax = 1.f;
+  // linear:    m * (x - c) + b
+  // quadratic: m * (x - c)^2 + b
+  // logistic:  m / (1 + exp(-k * (x - c))) + b
+  float m = 1.f;
+  float k = 1.f;
+  float b = 0.f;
+  float c = 0.f;
+  std::vector<float> points; // piecewise: values at evenly spaced x, at least 2 of them
+
+  float lut[lut_segments + 2] = {}; // last one duplicates the end so interpolation never reads past it
+
+  float shape(float x) const;
+  void bake();
+
+  float evaluate(float input) const;
+  // out[i] += curve(in[i])
+  void accumulate(const float *in, float *out, size_t count) const;
+};
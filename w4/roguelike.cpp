@@ -8,6 +8,13 @@
 #include "dungeonUtils.h"
 #include "dijkstraMapGen.h"
 #include "dmapFollower.h"
+#include "utilityScoring.h"
+#include "occupancyGrid.h"
+#include "turnResolver.h"
+#include "perception.h"
+#include "fieldOfView.h"
+#include "actionLog.h"
+#include <thread>
 
 static flecs::entity create_player_approacher(flecs::entity e)
 {
@@ -42,46 +49,30 @@ static flecs::entity create_hive(flecs::entity e)
 
 static void create_fuzzy_monster_beh(flecs::entity e)
 {
-  e.set(Blackboard{});
+  e.set(Blackboard{"fuzzy_monster"});
   BehNode *root =
-    utility_selector({
+    utility_selector(e, {
       std::make_pair(
         sequence({
           find_enemy(e, 4.f, "flee_enemy"),
           flee(e, "flee_enemy")
         }),
-        [](Blackboard &bb)
-        {
-          const float hp = bb.get<float>("hp");
-          const float enemyDist = bb.get<float>("enemyDist");
-          return (100.f - hp) * 5.f - 50.f * enemyDist;
-        }
+        "flee"
       ),
       std::make_pair(
         sequence({
           find_enemy(e, 3.f, "attack_enemy"),
           move_to_entity(e, "attack_enemy")
         }),
-        [](Blackboard &bb)
-        {
-          const float enemyDist = bb.get<float>("enemyDist");
-          return 100.f - 10.f * enemyDist;
-        }
+        "attack"
       ),
       std::make_pair(
         patrol(e, 2.f, "patrol_pos"),
-        [](Blackboard &)
-        {
-          return 50.f;
-        }
+        "patrol"
       ),
       std::make_pair(
         patch_up(100.f),
-        [](Blackboard &bb)
-        {
-          const float hp = bb.get<float>("hp");
-          return 140.f - hp;
-        }
+        "patch_up"
       )
     });
   e.add<WorldInfoGatherer>();
@@ -90,11 +81,11 @@ static void create_fuzzy_monster_beh(flecs::entity e)
 
 static void create_minotaur_beh(flecs::entity e)
 {
-  e.set(Blackboard{});
+  e.set(Blackboard{"minotaur"});
   BehNode *root =
     selector({
       sequence({
-        is_low_hp(50.f),
+        is_low_hp(e, 50.f),
         find_enemy(e, 4.f, "flee_enemy"),
         flee(e, "flee_enemy")
       }),
@@ -104,26 +95,33 @@ static void create_minotaur_beh(flecs::entity e)
       }),
       patrol(e, 2.f, "patrol_pos")
     });
+  // sensors feed "hp" and "enemyDist" which conditions observe
+  e.add<WorldInfoGatherer>();
   e.set(BehaviourTree{root});
 }
 
 static Position find_free_dungeon_tile(flecs::world &ecs)
 {
-  static auto findMonstersQuery = ecs.query<const Position, const Hitpoints>();
-  bool done = false;
-  while (!done)
+  static auto freeTileQuery = ecs.query<const FloorTiles, const OccupancyGrid>();
+  constexpr int maxRandomTries = 64;
+  Position res{0, 0};
+  freeTileQuery.each([&](const FloorTiles &ft, const OccupancyGrid &grid)
   {
-    done = true;
-    Position pos = dungeon::find_walkable_tile(ecs);
-    findMonstersQuery.each([&](const Position &p, const Hitpoints&)
+    for (int i = 0; i < maxRandomTries; ++i)
     {
-      if (p == pos)
-        done = false;
-    });
-    if (done)
-      return pos;
-  };
-  return {0, 0};
+      res = dungeon::random_floor_tile(ft);
+      if (!grid.actorAt(res.x, res.y))
+        return;
+    }
+    // almost full dungeon, just take the first free one
+    for (const Position &pos : ft.tiles)
+      if (!grid.actorAt(pos.x, pos.y))
+      {
+        res = pos;
+        return;
+      }
+  });
+  return res;
 }
 
 static flecs::entity create_monster(flecs::world &ecs, Color col, const char *texture_src)
@@ -142,6 +140,7 @@ static flecs::entity create_monster(flecs::world &ecs, Color col, const char *te
     .set(Team{1})
     .set(NumActions{1, 0})
     .set(MeleeDamage{20.f})
+    .set(Perception{})
     .set(Blackboard{});
 }
 
@@ -181,8 +180,25 @@ static void create_powerup(flecs::world &ecs, int x, int y, float amount)
     .set(Color{0xff, 0xff, 0x00, 0xff});
 }
 
+static void register_death_observers(flecs::world &ecs)
+{
+  static auto logQuery = ecs.query<ActionLog, const TurnCounter>();
+  ecs.observer<const Dead, const Hitpoints>()
+    .event(flecs::OnAdd)
+    .each([&](flecs::entity e, const Dead, const Hitpoints &)
+    {
+      logQuery.each([&](ActionLog &l, const TurnCounter &c)
+      {
+        l.push(c.count, ALE_DEATH, 0.f, e.has<IsPlayer>() ? "Player died" : "Monster died");
+      });
+    });
+}
+
 static void register_roguelike_systems(flecs::world &ecs)
 {
+  register_occupancy_observers(ecs);
+  register_death_observers(ecs);
+
   static auto dungeonDataQuery = ecs.query<const DungeonData>();
   ecs.system<PlayerInput, Action, const IsPlayer>()
     .each([&](PlayerInput &inp, Action &a, const IsPlayer)
@@ -300,8 +316,12 @@ static void register_roguelike_systems(flecs::world &ecs)
 }
 
 
-void init_roguelike(flecs::world &ecs)
+bool init_roguelike(flecs::world &ecs)
 {
+  // utility agents are built from these curves, nothing to run without them
+  if (!load_utility_curves("assets/utility_curves.txt"))
+    return false;
+
   register_roguelike_systems(ecs);
 
   ecs.entity("swordsman_tex")
@@ -326,6 +346,8 @@ void init_roguelike(flecs::world &ecs)
   ecs.entity("world")
     .set(TurnCounter{})
     .set(ActionLog{});
+
+  return true;
 }
 
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
@@ -340,8 +362,13 @@ void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
       dungeonData[y * w + x] = tiles[y * w + x];
+  const DungeonData dd{dungeonData, w, h};
   ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
+    .set(dd)
+    .set(dungeon::build_floor_tiles(dd))
+    .set(create_occupancy_grid(w, h))
+    .set(FovCache{});
+  ecs.set(dungeon::build_walkability(dd));
 
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
@@ -382,35 +409,26 @@ static bool upd_player_actions_count(flecs::world &ecs)
   return actionsReached;
 }
 
-static Position move_pos(Position pos, int action)
-{
-  if (action == EA_MOVE_LEFT)
-    pos.x--;
-  else if (action == EA_MOVE_RIGHT)
-    pos.x++;
-  else if (action == EA_MOVE_UP)
-    pos.y--;
-  else if (action == EA_MOVE_DOWN)
-    pos.y++;
-  return pos;
-}
-
-static void push_to_log(flecs::world &ecs, const char *msg)
-{
-  static auto queryLog = ecs.query<ActionLog, const TurnCounter>();
-  queryLog.each([&](ActionLog &l, const TurnCounter &c)
-  {
-    l.log.push_back(std::to_string(c.count) + ": " + msg);
-    if (l.log.size() > l.capacity)
-      l.log.erase(l.log.begin());
-  });
-}
-
 static void process_actions(flecs::world &ecs)
 {
   static auto processActions = ecs.query<Action, Position, MovePos, const MeleeDamage, const Team>();
   static auto processHeals = ecs.query<Action, Hitpoints>();
-  static auto checkAttacks = ecs.query<const MovePos, Hitpoints, const Team>();
+  static auto occupancyQuery = ecs.query<OccupancyGrid>();
+  static TurnResolver resolver;
+  const DungeonWalkability *walk = ecs.get<DungeonWalkability>();
+  static auto logQuery = ecs.query<ActionLog, const TurnCounter>();
+  ActionLog *actionLog = nullptr;
+  int turn = 0;
+  logQuery.each([&](ActionLog &l, const TurnCounter &c)
+  {
+    actionLog = &l;
+    turn = c.count;
+  });
+  auto push_to_log = [&](ActionLogEvent event, float amount, const char *msg)
+  {
+    if (actionLog)
+      actionLog->push(turn, event, amount, "%s", msg);
+  };
   // Process all actions
   ecs.defer([&]
   {
@@ -419,30 +437,39 @@ static void process_actions(flecs::world &ecs)
       if (a.action != EA_HEAL_SELF)
         return;
       a.action = EA_NOP;
-      push_to_log(ecs, "Monster healed itself");
-      hp.hitpoints += 10.f;
+      constexpr float healAmount = 10.f;
+      push_to_log(ALE_HEAL, healAmount, "Monster healed itself");
+      hp.hitpoints += healAmount;
 
     });
-    processActions.each([&](flecs::entity entity, Action &a, Position &pos, MovePos &mpos, const MeleeDamage &dmg, const Team &team)
+    occupancyQuery.each([&](OccupancyGrid &grid)
     {
-      Position nextPos = move_pos(pos, a.action);
-      bool blocked = !dungeon::is_tile_walkable(ecs, nextPos);
-      checkAttacks.each([&](flecs::entity enemy, const MovePos &epos, Hitpoints &hp, const Team &enemy_team)
+      if (!walk)
+        return;
+      resolver.clear();
+      processActions.each([&](flecs::entity entity, Action &a, Position &pos, MovePos &mpos, const MeleeDamage &dmg, const Team &team)
       {
-        if (entity != enemy && epos == nextPos)
+        resolver.actors.push_back({entity, &a, &mpos, pos, pos, team.team, dmg.damage, entity.has<IsPlayer>()});
+      });
+      resolver.resolve(*walk, grid, std::thread::hardware_concurrency());
+
+      for (const TurnAttack &attack : resolver.attacks)
+        attack.target.get([&](Hitpoints &hp)
         {
-          blocked = true;
-          if (team.team != enemy_team.team)
-          {
-            push_to_log(ecs, "damaged entity");
-            hp.hitpoints -= dmg.damage;
-          }
+          push_to_log(ALE_DAMAGE, attack.damage, "damaged entity");
+          hp.hitpoints -= attack.damage;
+        });
+      for (size_t i = 0; i < resolver.actors.size(); ++i)
+      {
+        const TurnActor &actor = resolver.actors[i];
+        if (!resolver.moves[i])
+        {
+          actor.action->action = EA_NOP;
+          continue;
         }
-      });
-      if (blocked)
-        a.action = EA_NOP;
-      else
-        mpos = nextPos;
+        grid.moveActor(actor.movePos->x, actor.movePos->y, actor.nextPos.x, actor.nextPos.y, actor.entity);
+        *actor.movePos = actor.nextPos;
+      }
     });
     // now move
     processActions.each([&](Action &a, Position &pos, MovePos &mpos, const MeleeDamage &, const Team&)
@@ -452,79 +479,49 @@ static void process_actions(flecs::world &ecs)
     });
   });
 
-  static auto deleteAllDead = ecs.query<const Hitpoints>();
+  static auto markDead = ecs.query<const Hitpoints>();
   ecs.defer([&]
   {
-    deleteAllDead.each([&](flecs::entity entity, const Hitpoints &hp)
+    markDead.each([&](flecs::entity entity, const Hitpoints &hp)
     {
-      if (hp.hitpoints <= 0.f)
-        entity.destruct();
+      if (hp.hitpoints <= 0.f && !entity.has<Dead>())
+        entity.add<Dead>();
     });
   });
 
   static auto playerPickup = ecs.query<const IsPlayer, const Position, Hitpoints, MeleeDamage>();
-  static auto healPickup = ecs.query<const Position, const HealAmount>();
-  static auto powerupPickup = ecs.query<const Position, const PowerupAmount>();
   ecs.defer([&]
   {
     playerPickup.each([&](const IsPlayer&, const Position &pos, Hitpoints &hp, MeleeDamage &dmg)
     {
-      healPickup.each([&](flecs::entity entity, const Position &ppos, const HealAmount &amt)
+      occupancyQuery.each([&](OccupancyGrid &grid)
       {
-        if (pos == ppos)
-        {
-          hp.hitpoints += amt.amount;
-          entity.destruct();
-        }
-      });
-      powerupPickup.each([&](flecs::entity entity, const Position &ppos, const PowerupAmount &amt)
-      {
-        if (pos == ppos)
-        {
-          dmg.damage += amt.amount;
-          entity.destruct();
-        }
+        flecs::entity pickup = grid.pickupAt(pos.x, pos.y);
+        if (!pickup)
+          return;
+        pickup.get([&](const HealAmount &amt) { hp.hitpoints += amt.amount; });
+        pickup.get([&](const PowerupAmount &amt) { dmg.damage += amt.amount; });
+        pickup.add<Dead>();
       });
     });
   });
-}
 
-template<typename T>
-static void push_info_to_bb(Blackboard &bb, const char *name, const T &val)
-{
-  size_t idx = bb.regName<T>(name);
-  bb.set(idx, val);
+  // death observers have already run when tags were added, drop everything in one go per table
+  ecs.delete_with<Dead>();
 }
 
 // sensors
 static void gather_world_info(flecs::world &ecs)
 {
   static auto gatherWorldInfo = ecs.query<Blackboard,
-                                          const Position, const Hitpoints,
-                                          const WorldInfoGatherer,
-                                          const Team>();
-  static auto alliesQuery = ecs.query<const Position, const Team>();
-  gatherWorldInfo.each([&](Blackboard &bb, const Position &pos, const Hitpoints &hp,
-                           WorldInfoGatherer, const Team &team)
+                                          const Hitpoints,
+                                          const Perception,
+                                          const WorldInfoGatherer>();
+  gatherWorldInfo.each([&](Blackboard &bb, const Hitpoints &hp, const Perception &p, WorldInfoGatherer)
   {
-    // first gather all needed names (without cache)
-    push_info_to_bb(bb, "hp", hp.hitpoints);
-    float numAllies = 0; // note float
-    float closestEnemyDist = 100.f;
-    alliesQuery.each([&](const Position &apos, const Team &ateam)
-    {
-      constexpr float limitDist = 5.f;
-      if (team.team == ateam.team && dist_sq(pos, apos) < sqr(limitDist))
-        numAllies += 1.f;
-      if (team.team != ateam.team)
-      {
-        const float enemyDist = dist(pos, apos);
-        if (enemyDist < closestEnemyDist)
-          closestEnemyDist = enemyDist;
-      }
-    });
-    push_info_to_bb(bb, "alliesNum", numAllies);
-    push_info_to_bb(bb, "enemyDist", closestEnemyDist);
+    bb.set(hp_key, hp.hitpoints);
+    bb.set(allies_num_key, p.alliesNum); // note float
+    bb.set(enemy_dist_key, p.closestEnemyDist(100.f));
   });
 }
 
@@ -538,7 +535,9 @@ void process_turn(flecs::world &ecs)
     if (upd_player_actions_count(ecs))
     {
       // Plan action for NPCs
+      gather_perception(ecs);
       gather_world_info(ecs);
+      score_utility_agents(ecs);
       ecs.defer([&]
       {
         stateMachineAct.each([&](flecs::entity e, StateMachine &sm)
@@ -590,9 +589,9 @@ void print_stats(flecs::world &ecs)
   actionLogQuery.each([&](const ActionLog &l)
   {
     int yPos = GetRenderHeight() - 20;
-    for (const std::string &msg : l.log)
+    for (size_t i = 0; i < l.count; ++i)
     {
-      DrawText(msg.c_str(), 20, yPos, 20, WHITE);
+      DrawText(l.get(i), 20, yPos, 20, WHITE);
       yPos -= 20;
     }
   });
@@ -0,0 +1,96 @@
+#include "turnResolver.h"
+#include "occupancyGrid.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <thread>
+
+// not worth spinning threads for the usual handful of monsters
+constexpr size_t min_actors_per_thread = 256;
+constexpr size_t no_tile = ~size_t(0);
+
+template<typename Callable>
+static void parallel_for(size_t count, unsigned num_threads, Callable c)
+{
+  const size_t numChunks = std::max(size_t(1), std::min(size_t(num_threads), count / min_actors_per_thread));
+  if (numChunks <= 1)
+  {
+    c(size_t(0), count);
+    return;
+  }
+  const size_t chunkSize = (count + numChunks - 1) / numChunks;
+  std::vector<std::thread> threads;
+  threads.reserve(numChunks - 1);
+  for (size_t chunk = 1; chunk < numChunks; ++chunk)
+    threads.emplace_back([&c, chunk, chunkSize, count]()
+    {
+      c(chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize));
+    });
+  c(size_t(0), std::min(count, chunkSize));
+  for (std::thread &thread : threads)
+    thread.join();
+}
+
+static Position move_pos(Position pos, int action)
+{
+  if (action == EA_MOVE_LEFT)
+    pos.x--;
+  else if (action == EA_MOVE_RIGHT)
+    pos.x++;
+  else if (action == EA_MOVE_UP)
+    pos.y--;
+  else if (action == EA_MOVE_DOWN)
+    pos.y++;
+  return pos;
+}
+
+void TurnResolver::clear()
+{
+  actors.clear();
+  claims.clear();
+  moves.clear();
+  attacks.clear();
+}
+
+void TurnResolver::resolve(const DungeonWalkability &walk, const OccupancyGrid &grid, unsigned num_threads)
+{
+  // phase 1: intents, each actor only reads its own data and the static map
+  claims.resize(actors.size());
+  moves.assign(actors.size(), 0);
+  parallel_for(actors.size(), num_threads, [&](size_t from, size_t to)
+  {
+    for (size_t i = from; i < to; ++i)
+    {
+      TurnActor &actor = actors[i];
+      const Position nextPos = move_pos(actor.pos, actor.action->action);
+      actor.nextPos = nextPos;
+      const bool wantsMove = nextPos != actor.pos && walk.isWalkable(nextPos);
+      const uint64_t priority = (actor.isPlayer ? 0ull : 1ull << 63) | (actor.entity.id() & ~(1ull << 63));
+      claims[i] = Claim{wantsMove ? size_t(nextPos.y) * walk.width + size_t(nextPos.x) : no_tile,
+                        priority, uint32_t(i)};
+    }
+  });
+
+  // phase 2: settle claims for each tile, tiles are taken as they were at the start of the turn
+  std::sort(claims.begin(), claims.end(), [](const Claim &lhs, const Claim &rhs)
+  {
+    return lhs.tile != rhs.tile ? lhs.tile < rhs.tile : lhs.priority < rhs.priority;
+  });
+  for (size_t i = 0; i < claims.size(); ++i)
+  {
+    const Claim &claim = claims[i];
+    if (claim.tile == no_tile)
+      continue;
+    const TurnActor &actor = actors[claim.actor];
+    const flecs::entity occupant = grid.actorAt(actor.nextPos.x, actor.nextPos.y);
+    if (occupant && occupant != actor.entity)
+    {
+      const Team *occupantTeam = occupant.get<Team>();
+      if (occupantTeam && occupantTeam->team != actor.team)
+        attacks.push_back({actor.entity, occupant, actor.damage});
+      continue;
+    }
+    // first claimant of a free tile gets it
+    if (i == 0 || claims[i - 1].tile != claim.tile)
+      moves[claim.actor] = 1;
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include <cstdint>
+#include "ecsTypes.h"
+
+struct OccupancyGrid;
+struct DungeonWalkability;
+
+// Everything resolution needs to know about one acting entity. Action and MovePos
+// point into component storage, so it's only valid while the turn is being processed.
+struct TurnActor
+{
+  flecs::entity entity;
+  Action *action;
+  MovePos *movePos;
+  Position pos;
+  Position nextPos; // filled by resolve
+  int team;
+  float damage;
+  bool isPlayer;
+};
+
+struct TurnAttack
+{
+  flecs::entity attacker;
+  flecs::entity target;
+  float damage;
+};
+
+// Two phase resolution: intents are computed independently (in parallel) into claims keyed by
+// target tile, then claims are settled in (tile, priority) order. Nothing depends on thread
+// count or query order, so the same turn always resolves the same way.
+struct TurnResolver
+{
+  struct Claim
+  {
+    size_t tile;
+    uint64_t priority; // lower wins, player first then by entity id
+    uint32_t actor;
+  };
+
+  std::vector<TurnActor> actors;
+  std::vector<Claim> claims;
+  std::vector<uint8_t> moves; // per actor
+  std::vector<TurnAttack> attacks;
+
+  void clear();
+  // fills moves and attacks, doesn't touch the world or the grid
+  void resolve(const DungeonWalkability &walk, const OccupancyGrid &grid, unsigned num_threads);
+};
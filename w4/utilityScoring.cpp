@@ -0,0 +1,189 @@
+#include "utilityScoring.h"
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <algorithm>
+
+struct UtilityBatch
+{
+  std::vector<UtilityScorer> scorers;
+
+  // per turn data, cleared but not deallocated between turns
+  UtilityInputs inputs;
+  std::vector<UtilityScores*> agents;
+  std::vector<float> scores; // scorers.size() arrays of inputs.count scores
+};
+
+static std::vector<UtilityBatch> utility_batches;
+// owned separately so pointers stay valid when curves are reloaded
+static std::vector<std::unique_ptr<CurveUtility>> curve_utilities;
+
+size_t register_utility_layout(const std::vector<UtilityScorer> &scorers)
+{
+  assert(scorers.size() <= max_utility_nodes);
+  for (size_t i = 0; i < utility_batches.size(); ++i)
+    if (utility_batches[i].scorers == scorers)
+      return i;
+  utility_batches.push_back(UtilityBatch{scorers, {}, {}, {}});
+  return utility_batches.size() - 1;
+}
+
+static CurveUtility *get_curve_utility(const std::string &name)
+{
+  for (std::unique_ptr<CurveUtility> &utility : curve_utilities)
+    if (utility->name == name)
+      return utility.get();
+  curve_utilities.push_back(std::make_unique<CurveUtility>(CurveUtility{name, {}}));
+  return curve_utilities.back().get();
+}
+
+const CurveUtility *find_curve_utility(const char *name)
+{
+  for (const std::unique_ptr<CurveUtility> &utility : curve_utilities)
+    if (utility->name == name)
+      return utility.get();
+  return nullptr;
+}
+
+static bool parse_consideration(std::istringstream &line, UtilityConsideration &consideration)
+{
+  std::string input;
+  std::string type;
+  if (!(line >> input >> type >> consideration.curve.inMin >> consideration.curve.inMax))
+    return false;
+  const char *inputNames[UI_NUM] = {"hp", "alliesNum", "enemyDist"};
+  const auto inputItf = std::find(inputNames, inputNames + UI_NUM, input);
+  if (inputItf == inputNames + UI_NUM)
+    return false;
+  consideration.input = UtilityInput(inputItf - inputNames);
+
+  ResponseCurve &curve = consideration.curve;
+  if (type == "piecewise")
+  {
+    curve.type = CURVE_PIECEWISE;
+    float y = 0.f;
+    while (line >> y)
+      curve.points.push_back(y);
+    // points must run up to the end of line
+    if (!line.eof() || curve.points.size() < 2)
+      return false;
+  }
+  else
+  {
+    const char *typeNames[] = {"linear", "quadratic", "logistic"};
+    const auto typeItf = std::find(std::begin(typeNames), std::end(typeNames), type);
+    if (typeItf == std::end(typeNames))
+      return false;
+    curve.type = CurveType(typeItf - std::begin(typeNames));
+    if (!(line >> curve.m >> curve.k >> curve.b >> curve.c))
+      return false;
+    // nothing is allowed after the last parameter
+    std::string rest;
+    if (line >> rest)
+      return false;
+  }
+  curve.bake();
+  return curve.inMax > curve.inMin;
+}
+
+bool load_utility_curves(const char *path)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    printf("can't open utility curves '%s'\n", path);
+    return false;
+  }
+  std::vector<std::pair<std::string, UtilityConsideration>> loaded;
+  std::string lineStr;
+  for (size_t lineNo = 1; std::getline(file, lineStr); ++lineNo)
+  {
+    std::istringstream line(lineStr);
+    std::string name;
+    if (!(line >> name) || name[0] == '#')
+      continue;
+    UtilityConsideration consideration;
+    if (!parse_consideration(line, consideration))
+    {
+      printf("%s:%zu: invalid utility consideration\n", path, lineNo);
+      return false;
+    }
+    loaded.emplace_back(name, consideration);
+  }
+  // replace only once whole file is valid
+  for (const auto &pair : loaded)
+    get_curve_utility(pair.first)->considerations.clear();
+  for (const auto &pair : loaded)
+    get_curve_utility(pair.first)->considerations.push_back(pair.second);
+  return true;
+}
+
+static void score_batch(const UtilityScorer &scorer, const UtilityInputs &inputs, float *scores)
+{
+  if (scorer.function)
+  {
+    scorer.function(inputs, scores);
+    return;
+  }
+  std::fill(scores, scores + inputs.count, 0.f);
+  if (!scorer.curves)
+    return;
+  for (const UtilityConsideration &consideration : scorer.curves->considerations)
+    consideration.curve.accumulate(inputs.get(consideration.input).data(), scores, inputs.count);
+}
+
+static void clear_batch(UtilityBatch &batch)
+{
+  batch.inputs.hp.clear();
+  batch.inputs.alliesNum.clear();
+  batch.inputs.enemyDist.clear();
+  batch.inputs.count = 0;
+  batch.agents.clear();
+}
+
+void score_utility_agents(flecs::world &ecs)
+{
+  static auto utilityAgentsQuery = ecs.query<UtilityScores, Blackboard>();
+
+  for (UtilityBatch &batch : utility_batches)
+    clear_batch(batch);
+
+  // gather
+  utilityAgentsQuery.each([&](UtilityScores &us, Blackboard &bb)
+  {
+    UtilityBatch &batch = utility_batches[us.layout];
+    batch.inputs.hp.push_back(bb.get(hp_key));
+    batch.inputs.alliesNum.push_back(bb.get(allies_num_key));
+    batch.inputs.enemyDist.push_back(bb.get(enemy_dist_key));
+    batch.inputs.count++;
+    batch.agents.push_back(&us);
+  });
+
+  for (UtilityBatch &batch : utility_batches)
+  {
+    const size_t count = batch.inputs.count;
+    const size_t numFunctions = batch.scorers.size();
+    if (count == 0)
+      continue;
+    // score, each function runs a tight loop over all agents
+    batch.scores.resize(numFunctions * count);
+    for (size_t fi = 0; fi < numFunctions; ++fi)
+      score_batch(batch.scorers[fi], batch.inputs, batch.scores.data() + fi * count);
+
+    // scatter back and pick the best action
+    for (size_t i = 0; i < count; ++i)
+    {
+      UtilityScores &us = *batch.agents[i];
+      us.numScores = numFunctions;
+      us.bestIdx = 0;
+      for (size_t fi = 0; fi < numFunctions; ++fi)
+      {
+        us.scores[fi] = batch.scores[fi * count + i];
+        if (us.scores[fi] > us.scores[us.bestIdx])
+          us.bestIdx = fi;
+      }
+    }
+  }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include <string>
+#include "blackboard.h"
+#include "responseCurve.h"
+
+constexpr size_t max_utility_nodes = 8;
+
+// sensor values utility functions are allowed to depend on
+inline const BlackboardKey<float> hp_key{"hp"};
+inline const BlackboardKey<float> allies_num_key{"alliesNum"};
+inline const BlackboardKey<float> enemy_dist_key{"enemyDist"};
+
+enum UtilityInput
+{
+  UI_HP = 0,
+  UI_ALLIES_NUM,
+  UI_ENEMY_DIST,
+  UI_NUM
+};
+
+// inputs of all agents sharing the same set of utility functions, one array per input
+struct UtilityInputs
+{
+  std::vector<float> hp;
+  std::vector<float> alliesNum;
+  std::vector<float> enemyDist;
+  size_t count = 0;
+
+  const std::vector<float> &get(UtilityInput input) const
+  {
+    return input == UI_HP ? hp : input == UI_ALLIES_NUM ? alliesNum : enemyDist;
+  }
+};
+
+// scores all agents of the batch at once: scores[i] is utility of agent i
+using utility_function = void (*)(const UtilityInputs &in, float *scores);
+
+struct UtilityConsideration
+{
+  UtilityInput input = UI_HP;
+  ResponseCurve curve;
+};
+
+// data driven utility: sum of considerations
+struct CurveUtility
+{
+  std::string name;
+  std::vector<UtilityConsideration> considerations;
+};
+
+// either hand written function or curves loaded from data
+struct UtilityScorer
+{
+  utility_function function = nullptr;
+  const CurveUtility *curves = nullptr;
+};
+
+inline bool operator==(const UtilityScorer &lhs, const UtilityScorer &rhs)
+{
+  return lhs.function == rhs.function && lhs.curves == rhs.curves;
+}
+
+// precomputed by score_utility_agents, consumed by utility selector
+struct UtilityScores
+{
+  size_t layout = 0;
+  size_t numScores = 0;
+  size_t bestIdx = 0;
+  float scores[max_utility_nodes];
+};
+
+size_t register_utility_layout(const std::vector<UtilityScorer> &scorers);
+
+// Reads utilities from text file, one consideration per line:
+//   <utility> <input> linear|quadratic|logistic <inMin> <inMax> <m> <k> <b> <c>
+//   <utility> <input> piecewise <inMin> <inMax> <y0> <y1> ... <yn>
+// Utilities which are already loaded are updated in place.
+bool load_utility_curves(const char *path);
+// null if nothing with this name was loaded
+const CurveUtility *find_curve_utility(const char *name);
+
+// gathers sensor values of all utility agents into arrays and scores them in batches
+void score_utility_agents(flecs::world &ecs);
@@ -156,8 +156,6 @@ struct ActionLog
   size_t capacity = 5;
 };
 
-struct BackgroundTile {};
-
 struct DungeonData
 {
   std::vector<char> tiles; // for pathfinding
@@ -0,0 +1,106 @@
+#include "flowField.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <limits>
+
+static bool is_floor(const DungeonData &dd, int x, int y)
+{
+  if (x < 0 || y < 0 || x >= int(dd.width) || y >= int(dd.height))
+    return false;
+  return dd.tiles[size_t(y) * dd.width + size_t(x)] == dungeon::floor;
+}
+
+// diagonal moves are allowed only if they don't cut wall corners
+static bool can_step(const DungeonData &dd, int x, int y, int dx, int dy)
+{
+  if (!is_floor(dd, x + dx, y + dy))
+    return false;
+  return dx == 0 || dy == 0 || (is_floor(dd, x + dx, y) && is_floor(dd, x, y + dy));
+}
+
+constexpr IVec2 neighbours[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {-1, -1}, {1, -1}, {-1, 1}, {1, 1}};
+
+FlowField create_flow_field(float tile_size)
+{
+  FlowField res;
+  res.tileSize = tile_size;
+  return res;
+}
+
+IVec2 FlowField::tileOf(const Position &pos) const
+{
+  // positions are top left corners of sprites
+  return IVec2{int(floorf(pos.x / tileSize + 0.5f)), int(floorf(pos.y / tileSize + 0.5f))};
+}
+
+bool FlowField::update(const DungeonData &dd, const Position &target_pos)
+{
+  const IVec2 targetTile = tileOf(target_pos);
+  if (targetTile == target || !is_floor(dd, targetTile.x, targetTile.y))
+    return false;
+  target = targetTile;
+  width = dd.width;
+  height = dd.height;
+
+  const size_t numTiles = dd.width * dd.height;
+  cost.assign(numTiles, std::numeric_limits<float>::max());
+  dir.assign(numTiles, Position{0.f, 0.f});
+
+  auto cmp = [](const QueueItem &lhs, const QueueItem &rhs) { return lhs.cost > rhs.cost; };
+  queue.clear();
+  const size_t targetIdx = size_t(target.y) * dd.width + size_t(target.x);
+  cost[targetIdx] = 0.f;
+  queue.push_back({0.f, targetIdx});
+  while (!queue.empty())
+  {
+    std::pop_heap(queue.begin(), queue.end(), cmp);
+    const QueueItem cur = queue.back();
+    queue.pop_back();
+    if (cur.cost > cost[cur.idx])
+      continue;
+    const int x = int(cur.idx % dd.width);
+    const int y = int(cur.idx / dd.width);
+    for (const IVec2 &n : neighbours)
+    {
+      if (!can_step(dd, x, y, n.x, n.y))
+        continue;
+      const size_t nidx = size_t(y + n.y) * dd.width + size_t(x + n.x);
+      const float ncost = cur.cost + (n.x != 0 && n.y != 0 ? 1.41421356f : 1.f);
+      if (ncost >= cost[nidx])
+        continue;
+      cost[nidx] = ncost;
+      queue.push_back({ncost, nidx});
+      std::push_heap(queue.begin(), queue.end(), cmp);
+    }
+  }
+
+  // every tile points to its cheapest neighbour
+  for (size_t idx = 0; idx < numTiles; ++idx)
+  {
+    if (idx == targetIdx || cost[idx] == std::numeric_limits<float>::max())
+      continue;
+    const int x = int(idx % dd.width);
+    const int y = int(idx / dd.width);
+    float bestCost = cost[idx];
+    for (const IVec2 &n : neighbours)
+    {
+      if (!can_step(dd, x, y, n.x, n.y))
+        continue;
+      const float ncost = cost[size_t(y + n.y) * dd.width + size_t(x + n.x)];
+      if (ncost < bestCost)
+      {
+        bestCost = ncost;
+        dir[idx] = normalize(Position{float(n.x), float(n.y)});
+      }
+    }
+  }
+  return true;
+}
+
+Position FlowField::direction(const Position &pos) const
+{
+  const IVec2 tile = tileOf(pos);
+  if (dir.empty() || tile.x < 0 || tile.y < 0 || tile.x >= int(width) || tile.y >= int(height))
+    return Position{0.f, 0.f};
+  return dir[size_t(tile.y) * width + size_t(tile.x)];
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "ecsTypes.h"
+#include "math.h"
+
+// Dijkstra field towards a single target tile, every tile stores direction to follow.
+// Only rebuilt when target moves to another tile.
+struct FlowField
+{
+  float tileSize = 0.f;
+  size_t width = 0;
+  size_t height = 0;
+  IVec2 target{-1, -1};
+  std::vector<float> cost;
+  std::vector<Position> dir; // zero on walls, unreachable tiles and on target itself
+
+  struct QueueItem
+  {
+    float cost;
+    size_t idx;
+  };
+  std::vector<QueueItem> queue;
+
+  IVec2 tileOf(const Position &pos) const;
+  // returns true if the field was rebuilt
+  bool update(const DungeonData &dd, const Position &target_pos);
+  // direction to follow from pos, zero if there's none
+  Position direction(const Position &pos) const;
+};
+
+FlowField create_flow_field(float tile_size);
@@ -0,0 +1,97 @@
+#include "integrator.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define INTEGRATOR_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define INTEGRATOR_SSE 1
+#endif
+
+static_assert(sizeof(Position) == 2 * sizeof(float), "Position columns are read as interleaved xy floats");
+static_assert(sizeof(Velocity) == sizeof(Position) && sizeof(SteerDir) == sizeof(Position));
+static_assert(sizeof(MoveSpeed) == sizeof(float));
+
+constexpr size_t block_size = 8;
+
+// columns are arrays of xy pairs, so vectors hold x0 y0 x1 y1 ... and per entity scalars
+// are duplicated into both lanes of their pair
+#if INTEGRATOR_AVX
+constexpr size_t lane_entities = 4;
+using vecf = __m256;
+
+static vecf load(const float *p) { return _mm256_loadu_ps(p); }
+static void store(float *p, vecf v) { _mm256_storeu_ps(p, v); }
+static vecf splat(float v) { return _mm256_set1_ps(v); }
+static vecf add(vecf a, vecf b) { return _mm256_add_ps(a, b); }
+static vecf mul(vecf a, vecf b) { return _mm256_mul_ps(a, b); }
+
+static vecf load_pairs(const float *p)
+{
+  const __m128 s = _mm_loadu_ps(p);
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_unpacklo_ps(s, s)), _mm_unpackhi_ps(s, s), 1);
+}
+
+static vecf truncate(vecf v, vecf len)
+{
+  const vecf sq = mul(v, v);
+  const vecf l = _mm256_sqrt_ps(add(sq, _mm256_permute_ps(sq, _MM_SHUFFLE(2, 3, 0, 1))));
+  const vecf scale = _mm256_blendv_ps(splat(1.f), _mm256_div_ps(len, l), _mm256_cmp_ps(l, len, _CMP_GT_OQ));
+  return mul(v, scale);
+}
+#elif INTEGRATOR_SSE
+constexpr size_t lane_entities = 2;
+using vecf = __m128;
+
+static vecf load(const float *p) { return _mm_loadu_ps(p); }
+static void store(float *p, vecf v) { _mm_storeu_ps(p, v); }
+static vecf splat(float v) { return _mm_set1_ps(v); }
+static vecf add(vecf a, vecf b) { return _mm_add_ps(a, b); }
+static vecf mul(vecf a, vecf b) { return _mm_mul_ps(a, b); }
+
+static vecf load_pairs(const float *p) { return _mm_set_ps(p[1], p[1], p[0], p[0]); }
+
+static vecf truncate(vecf v, vecf len)
+{
+  const vecf sq = mul(v, v);
+  const vecf l = _mm_sqrt_ps(add(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1))));
+  const vecf longer = _mm_cmpgt_ps(l, len);
+  const vecf scale = _mm_or_ps(_mm_and_ps(longer, _mm_div_ps(len, l)), _mm_andnot_ps(longer, splat(1.f)));
+  return mul(v, scale);
+}
+#endif
+
+static const float *floats(const Position *p) { return reinterpret_cast<const float*>(p); }
+static float *floats(Position *p) { return reinterpret_cast<float*>(p); }
+
+void integrator::integrate_velocity(Velocity *vel, const SteerDir *sd, const MoveSpeed *ms, const float *accel,
+                                    size_t count, float dt)
+{
+  size_t i = 0;
+#if INTEGRATOR_AVX || INTEGRATOR_SSE
+  const float *speed = reinterpret_cast<const float*>(ms);
+  const vecf dtv = splat(dt);
+  for (; i + block_size <= count; i += block_size)
+    for (size_t j = i; j < i + block_size; j += lane_entities)
+    {
+      const vecf len = load_pairs(speed + j);
+      const vecf steer = mul(mul(truncate(load(floats(sd + j)), len), dtv), load_pairs(accel + j));
+      store(floats(vel + j), truncate(add(load(floats(vel + j)), steer), len));
+    }
+#endif
+  for (; i < count; ++i)
+    vel[i] = Velocity{truncate(vel[i] + truncate(sd[i], ms[i].speed) * dt * accel[i], ms[i].speed)};
+}
+
+void integrator::integrate_position(Position *pos, const Velocity *vel, size_t count, float dt)
+{
+  size_t i = 0;
+#if INTEGRATOR_AVX || INTEGRATOR_SSE
+  const vecf dtv = splat(dt);
+  for (; i + block_size <= count; i += block_size)
+    for (size_t j = i; j < i + block_size; j += lane_entities)
+      store(floats(pos + j), add(load(floats(pos + j)), mul(load(floats(vel + j)), dtv)));
+#endif
+  for (; i < count; ++i)
+    pos[i] += vel[i] * dt;
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include <cstddef>
+#include "ecsTypes.h"
+
+// Batched kernels over whole flecs table columns, entities are processed in blocks of 8
+// with AVX (or SSE2) and the remainder goes through the scalar path.
+namespace integrator
+{
+  // vel = truncate(vel + truncate(sd, speed) * dt * accel, speed)
+  void integrate_velocity(Velocity *vel, const SteerDir *sd, const MoveSpeed *ms, const float *accel,
+                          size_t count, float dt);
+  // pos += vel * dt
+  void integrate_position(Position *pos, const Velocity *vel, size_t count, float dt);
+};
@@ -1,6 +1,9 @@
 #include "raylib.h"
 #include <flecs.h>
 #include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 
 #include "ecsTypes.h"
 #include "shootEmUp.h"
@@ -22,8 +25,14 @@ static void update_camera(flecs::world &ecs)
 }
 
 
-int main(int /*argc*/, const char ** /*argv*/)
+int main(int argc, const char **argv)
 {
+  // -t <num> sets number of ecs worker threads, defaults to hardware concurrency
+  int numThreads = int(std::thread::hardware_concurrency());
+  for (int i = 1; i + 1 < argc; ++i)
+    if (strcmp(argv[i], "-t") == 0)
+      numThreads = atoi(argv[++i]);
+
   int width = 1920;
   int height = 1080;
   InitWindow(width, height, "w6 AI MIPT");
@@ -38,6 +47,8 @@ int main(int /*argc*/, const char ** /*argv*/)
   }
 
   flecs::world ecs;
+  if (numThreads > 1)
+    ecs.set_threads(numThreads);
   {
     constexpr size_t dungWidth = 50;
     constexpr size_t dungHeight = 50;
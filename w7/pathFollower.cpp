@@ -0,0 +1,147 @@
+#include "pathFollower.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+  struct NavSnapshot
+  {
+    DungeonData dungeon;
+    DungeonPortals portals;
+  };
+
+  struct PathJob
+  {
+    uint32_t ticket;
+    IVec2 from;
+    IVec2 to;
+  };
+
+  struct PathResult
+  {
+    uint32_t ticket;
+    std::vector<IVec2> path;
+  };
+
+  class PathWorker
+  {
+  public:
+    ~PathWorker()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+      }
+      cv.notify_one();
+      if (thread.joinable())
+        thread.join();
+    }
+
+    uint32_t push(const DungeonData &dd, const DungeonPortals &dp, IVec2 from, IVec2 to)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!nav)
+      {
+        // dungeon doesn't change after it's built, so one copy is enough
+        nav = std::make_unique<const NavSnapshot>(NavSnapshot{dd, dp});
+        thread = std::thread([this]() { run(); });
+      }
+      const uint32_t ticket = nextTicket++;
+      if (nextTicket == 0)
+        nextTicket = 1;
+      jobs.push_back({ticket, from, to});
+      cv.notify_one();
+      return ticket;
+    }
+
+    bool take(uint32_t ticket, std::vector<IVec2> &res)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (size_t i = 0; i < done.size(); ++i)
+      {
+        if (done[i].ticket != ticket)
+          continue;
+        res = std::move(done[i].path);
+        done[i] = std::move(done.back());
+        done.pop_back();
+        return true;
+      }
+      return false;
+    }
+
+    void cancel(uint32_t ticket)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto it = jobs.begin(); it != jobs.end(); ++it)
+        if (it->ticket == ticket)
+        {
+          jobs.erase(it);
+          return;
+        }
+      for (size_t i = 0; i < done.size(); ++i)
+        if (done[i].ticket == ticket)
+        {
+          done[i] = std::move(done.back());
+          done.pop_back();
+          return;
+        }
+      // it's being searched right now
+      cancelled.push_back(ticket);
+    }
+
+  private:
+    void run()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (true)
+      {
+        cv.wait(lock, [this]() { return stop || !jobs.empty(); });
+        if (stop)
+          return;
+        const PathJob job = jobs.front();
+        jobs.pop_front();
+        lock.unlock();
+        std::vector<IVec2> path = find_portal_path(nav->dungeon, nav->portals, job.from, job.to);
+        lock.lock();
+        auto cancelledIt = std::find(cancelled.begin(), cancelled.end(), job.ticket);
+        if (cancelledIt != cancelled.end())
+        {
+          cancelled.erase(cancelledIt);
+          continue;
+        }
+        done.push_back({job.ticket, std::move(path)});
+      }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+    std::unique_ptr<const NavSnapshot> nav;
+    std::deque<PathJob> jobs;
+    std::vector<PathResult> done;
+    std::vector<uint32_t> cancelled;
+    uint32_t nextTicket = 1;
+    bool stop = false;
+  };
+
+  PathWorker worker;
+}
+
+uint32_t path_requests::request(const DungeonData &dd, const DungeonPortals &dp, IVec2 from, IVec2 to)
+{
+  return worker.push(dd, dp, from, to);
+}
+
+bool path_requests::take(uint32_t ticket, std::vector<IVec2> &res)
+{
+  return worker.take(ticket, res);
+}
+
+void path_requests::cancel(uint32_t ticket)
+{
+  worker.cancel(ticket);
+}
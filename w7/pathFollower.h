@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "ecsTypes.h"
+#include "math.h"
+#include "pathfinder.h"
+
+// Portal corridor towards the target, reused until the target moves further than
+// repathTiles away from the tile it was requested for.
+struct PathFollower
+{
+  std::vector<IVec2> corridor; // one tile per crossed portal, then the goal
+  size_t next = 0;
+  IVec2 goal{-1, -1};
+  uint32_t ticket = 0; // pending request, 0 if there's none
+  int repathTiles = 3;
+};
+
+// Paths are searched on a background thread over a snapshot of the dungeon taken on first request.
+namespace path_requests
+{
+  uint32_t request(const DungeonData &dd, const DungeonPortals &dp, IVec2 from, IVec2 to);
+  // moves the path to res and returns true once the request is done
+  bool take(uint32_t ticket, std::vector<IVec2> &res);
+  // drops the request, its result will never be stored
+  void cancel(uint32_t ticket);
+};
@@ -239,3 +239,102 @@ void prebuild_map(flecs::world &ecs)
   });
 }
 
+static IVec2 portal_center(const PathPortal &portal, IVec2 lim_min, IVec2 lim_max)
+{
+  // part of the portal inside the given super tile
+  const int startX = std::max(int(portal.startX), lim_min.x);
+  const int endX = std::min(int(portal.endX), lim_max.x - 1);
+  const int startY = std::max(int(portal.startY), lim_min.y);
+  const int endY = std::min(int(portal.endY), lim_max.y - 1);
+  return IVec2{(startX + endX) / 2, (startY + endY) / 2};
+}
+
+std::vector<IVec2> find_portal_path(const DungeonData &dd, const DungeonPortals &dp, IVec2 from, IVec2 to)
+{
+  if (from.x < 0 || from.y < 0 || from.x >= int(dd.width) || from.y >= int(dd.height) ||
+      to.x < 0 || to.y < 0 || to.x >= int(dd.width) || to.y >= int(dd.height))
+    return std::vector<IVec2>();
+  const int ts = int(dp.tileSplit);
+  const size_t superWidth = dd.width / dp.tileSplit;
+  auto super_lim = [&](IVec2 p, IVec2 &lim_min, IVec2 &lim_max)
+  {
+    lim_min = IVec2{p.x / ts * ts, p.y / ts * ts};
+    lim_max = IVec2{lim_min.x + ts, lim_min.y + ts};
+  };
+  auto super_idx = [&](IVec2 p) { return size_t(p.y / ts) * superWidth + size_t(p.x / ts); };
+  if (super_idx(from) >= dp.tilePortalsIndices.size() || super_idx(to) >= dp.tilePortalsIndices.size())
+    return std::vector<IVec2>();
+
+  IVec2 fromMin, fromMax, toMin, toMax;
+  super_lim(from, fromMin, fromMax);
+  super_lim(to, toMin, toMax);
+  if (super_idx(from) == super_idx(to) && !find_path_a_star(dd, from, to, fromMin, fromMax).empty())
+    return {to};
+
+  // nodes are portals, then start and goal
+  const size_t numPortals = dp.portals.size();
+  const size_t startNode = numPortals;
+  const size_t goalNode = numPortals + 1;
+  std::vector<float> g(numPortals + 2, std::numeric_limits<float>::max());
+  std::vector<size_t> prev(numPortals + 2, numPortals + 2);
+  std::vector<float> goalCost(numPortals, std::numeric_limits<float>::max());
+  for (size_t idx : dp.tilePortalsIndices[super_idx(to)])
+  {
+    std::vector<IVec2> path = find_path_a_star(dd, portal_center(dp.portals[idx], toMin, toMax), to, toMin, toMax);
+    if (!path.empty())
+      goalCost[idx] = float(path.size());
+  }
+
+  struct OpenNode
+  {
+    float f;
+    size_t node;
+  };
+  auto cmp = [](const OpenNode &lhs, const OpenNode &rhs) { return lhs.f > rhs.f; };
+  std::vector<OpenNode> openList;
+  auto push = [&](size_t node, size_t from_node, float cost, IVec2 pos)
+  {
+    if (cost >= g[node])
+      return;
+    g[node] = cost;
+    prev[node] = from_node;
+    openList.push_back({cost + heuristic(pos, to), node});
+    std::push_heap(openList.begin(), openList.end(), cmp);
+  };
+  auto portal_pos = [&](size_t idx)
+  {
+    const PathPortal &portal = dp.portals[idx];
+    return IVec2{int(portal.startX + portal.endX) / 2, int(portal.startY + portal.endY) / 2};
+  };
+
+  g[startNode] = 0.f;
+  for (size_t idx : dp.tilePortalsIndices[super_idx(from)])
+  {
+    std::vector<IVec2> path = find_path_a_star(dd, from, portal_center(dp.portals[idx], fromMin, fromMax),
+                                               fromMin, fromMax);
+    if (!path.empty())
+      push(idx, startNode, float(path.size()), portal_pos(idx));
+  }
+  while (!openList.empty())
+  {
+    std::pop_heap(openList.begin(), openList.end(), cmp);
+    const OpenNode cur = openList.back();
+    openList.pop_back();
+    if (cur.node == goalNode)
+      break;
+    if (cur.f - heuristic(portal_pos(cur.node), to) > g[cur.node])
+      continue;
+    if (goalCost[cur.node] < std::numeric_limits<float>::max())
+      push(goalNode, cur.node, g[cur.node] + goalCost[cur.node], to);
+    for (const PortalConnection &conn : dp.portals[cur.node].conns)
+      push(conn.connIdx, cur.node, g[cur.node] + conn.score, portal_pos(conn.connIdx));
+  }
+  if (prev[goalNode] > numPortals)
+    return std::vector<IVec2>();
+
+  std::vector<IVec2> res = {to};
+  for (size_t node = prev[goalNode]; node != startNode; node = prev[node])
+    res.push_back(portal_pos(node));
+  std::reverse(res.begin(), res.end());
+  return res;
+}
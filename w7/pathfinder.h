@@ -1,6 +1,8 @@
 #pragma once
 #include <flecs.h>
 #include <vector>
+#include "ecsTypes.h"
+#include "math.h"
 
 struct PortalConnection
 {
@@ -23,4 +25,6 @@ struct DungeonPortals
 };
 
 void prebuild_map(flecs::world &ecs);
-
+// Hierarchical search over portals, returns tiles to go through (one per crossed portal) ending with to.
+// Empty if there's no path.
+std::vector<IVec2> find_portal_path(const DungeonData &dd, const DungeonPortals &dp, IVec2 from, IVec2 to);
@@ -1,20 +1,45 @@
 #include "rlikeObjects.h"
 #include "ecsTypes.h"
 
-flecs::entity create_monster(flecs::world &ecs, Position pos, Color col, const char *texture_src)
+flecs::entity create_monster_prefab(flecs::world &ecs, const char *name, Color col, const char *texture_src)
 {
   flecs::entity textureSrc = ecs.entity(texture_src);
-  return ecs.entity()
+  return ecs.prefab(name)
+    .set_override(Position{0.f, 0.f})
+    .set_override(Velocity{0.f, 0.f})
+    .set_override(MoveSpeed{100.f})
+    .set_override(Hitpoints{100.f})
+    .set_override(Action{EA_NOP})
+    .set_override(Color{col})
+    .override<TextureSource>(textureSrc)
+    .set_override(Team{1})
+    .set_override(NumActions{1, 0})
+    .set_override(MeleeDamage{20.f});
+}
+
+static std::unordered_map<flecs::entity_t, std::vector<flecs::entity>> monster_pools;
+
+flecs::entity spawn_monster(flecs::world &ecs, flecs::entity prefab, Position pos)
+{
+  std::vector<flecs::entity> &pool = monster_pools[prefab.id()];
+  if (pool.empty())
+    return ecs.entity().is_a(prefab).set(Position{pos.x, pos.y});
+
+  flecs::entity e = pool.back();
+  pool.pop_back();
+  // enabling removes the Disabled tag, one move back to the original table, values reset to the prefab ones
+  return e.enable()
     .set(Position{pos.x, pos.y})
     .set(Velocity{0.f, 0.f})
-    .set(MoveSpeed{100.f})
-    .set(Hitpoints{100.f})
-    .set(Action{EA_NOP})
-    .set(Color{col})
-    .add<TextureSource>(textureSrc)
-    .set(Team{1})
-    .set(NumActions{1, 0})
-    .set(MeleeDamage{20.f});
+    .set(*prefab.get<Hitpoints>())
+    .set(Action{EA_NOP});
+}
+
+void recycle_monster(flecs::entity e)
+{
+  monster_pools[e.target(flecs::IsA).id()].push_back(e);
+  // adds the Disabled tag, so it's a move to the disabled twin of its table
+  e.disable();
 }
 
 void create_player(flecs::world &ecs, Position pos, const char *texture_src)
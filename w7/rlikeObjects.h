@@ -3,7 +3,12 @@
 #include "raylib.h"
 #include "ecsTypes.h"
 
-flecs::entity create_monster(flecs::world &ecs, Position pos, Color col, const char *texture_src);
+// every component is overridden, so an instance gets its own copies in a single table move
+flecs::entity create_monster_prefab(flecs::world &ecs, const char *name, Color col, const char *texture_src);
+// reuses a recycled monster of this prefab if there's one
+flecs::entity spawn_monster(flecs::world &ecs, flecs::entity prefab, Position pos);
+// disables the monster and keeps it for the next spawn instead of deleting
+void recycle_monster(flecs::entity e);
 void create_player(flecs::world &ecs, Position pos, const char *texture_src);
 
 struct MonsterSpawner
@@ -6,9 +6,33 @@
 #include "dungeonGen.h"
 #include "dungeonUtils.h"
 #include "pathfinder.h"
+#include "integrator.h"
+#include "wallField.h"
+#include "flowField.h"
+#include "tileMap.h"
+#include "spatialHash.h"
+#include <algorithm>
 
 constexpr float tile_size = 64.f;
 
+static const char *monster_prefabs[steer::Type::Num] =
+{
+  "seeker_prefab",
+  "pursuer_prefab",
+  "evader_prefab",
+  "fleer_prefab"
+};
+
+static void draw_sprite(flecs::entity e, const Position &pos, const Color color)
+{
+  const auto textureSrc = e.target<TextureSource>();
+  if (!textureSrc)
+    return;
+  DrawTextureQuad(*textureSrc.get<Texture2D>(),
+      Vector2{1, 1}, Vector2{0, 0},
+      Rectangle{float(pos.x), float(pos.y), tile_size, tile_size}, color);
+}
+
 static void register_roguelike_systems(flecs::world &ecs)
 {
   static auto playerPosQuery = ecs.query<const Position, const IsPlayer>();
@@ -25,29 +49,24 @@ static void register_roguelike_systems(flecs::world &ecs)
       vel = Velocity{normalize(vel) * ms.speed};
     });
   ecs.system<Position, const Velocity>()
-    .each([&](Position &pos, const Velocity &vel)
+    .multi_threaded()
+    .iter([&](flecs::iter &it, Position *pos, const Velocity *vel)
     {
-      pos += vel * ecs.delta_time();
+      integrator::integrate_position(pos, vel, it.count(), it.delta_time());
     });
-  ecs.system<const Position, const Color>()
-    .term<TextureSource>(flecs::Wildcard)
-    .term<BackgroundTile>()
-    .each([&](flecs::entity e, const Position &pos, const Color color)
+  static auto cameraQuery = ecs.query<const Camera2D>();
+  ecs.system<const TileMap>()
+    .each([&](const TileMap &tm)
     {
-      const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
-          Rectangle{float(pos.x), float(pos.y), tile_size, tile_size}, color);
+      cameraQuery.each([&](const Camera2D &cam) { tm.draw(camera_view_rect(cam)); });
     });
+  // actors are drawn after steering through the spatial hash, these are the leftovers
   ecs.system<const Position, const Color>()
     .term<TextureSource>(flecs::Wildcard)
-    .term<BackgroundTile>().not_()
+    .term<Hitpoints>().not_()
     .each([&](flecs::entity e, const Position &pos, const Color color)
     {
-      const auto textureSrc = e.target<TextureSource>();
-      DrawTextureQuad(*textureSrc.get<Texture2D>(),
-          Vector2{1, 1}, Vector2{0, 0},
-          Rectangle{float(pos.x), float(pos.y), tile_size, tile_size}, color);
+      draw_sprite(e, pos, color);
     });
 
   ecs.system<Texture2D>()
@@ -65,44 +84,70 @@ static void register_roguelike_systems(flecs::world &ecs)
         while (ms.timeToSpawn < 0.f)
         {
           steer::Type st = steer::Type(GetRandomValue(0, steer::Type::Num - 1));
-          const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
           const float distances[steer::Type::Num] = {800.f, 800.f, 300.f, 300.f};
           const float dist = distances[st];
           constexpr int angRandMax = 1 << 16;
           const float angle = float(GetRandomValue(0, angRandMax)) / float(angRandMax) * PI * 2.f;
-          Color col = colors[st];
-          steer::create_steer_beh(create_monster(ecs,
-              {pp.x + cosf(angle) * dist, pp.y + sinf(angle) * dist}, col, "minotaur_tex"), st);
+          flecs::entity monster = spawn_monster(ecs, ecs.entity(monster_prefabs[st]),
+              {pp.x + cosf(angle) * dist, pp.y + sinf(angle) * dist});
+          steer::reset_steer_state(monster);
           ms.timeToSpawn += ms.timeBetweenSpawns;
         }
       });
     });
 
-  static auto cameraQuery = ecs.query<const Camera2D>();
+  // dead and far away monsters go back to the pool
+  ecs.system<const Position, const Hitpoints, const Team>()
+    .term<IsPlayer>().not_()
+    .each([&](flecs::entity e, const Position &pos, const Hitpoints &hp, const Team &)
+    {
+      constexpr float despawnDist = 3000.f;
+      bool farAway = false;
+      playerPosQuery.each([&](const Position &pp, const IsPlayer &)
+      {
+        farAway = length_sq(pos - pp) > despawnDist * despawnDist;
+      });
+      if (hp.hitpoints <= 0.f || farAway)
+        recycle_monster(e);
+    });
+
   ecs.system<const DungeonPortals, const DungeonData>()
     .each([&](const DungeonPortals &dp, const DungeonData &dd)
     {
-      size_t w = dd.width;
-      size_t ts = dp.tileSplit;
-      for (size_t y = 0; y < dd.height / ts; ++y)
-        DrawLineEx(Vector2{0.f, y * ts * tile_size},
-                   Vector2{dd.width * tile_size, y * ts * tile_size}, 1.f, GetColor(0xff000080));
-      for (size_t x = 0; x < dd.width / ts; ++x)
-        DrawLineEx(Vector2{x * ts * tile_size, 0.f},
-                   Vector2{x * ts * tile_size, dd.height * tile_size}, 1.f, GetColor(0xff000080));
+      const size_t ts = dp.tileSplit;
+      const size_t wd = dd.width / ts;
+      const size_t hd = dd.height / ts;
+      if (wd == 0 || hd == 0)
+        return;
       cameraQuery.each([&](Camera2D cam)
       {
+        // only clusters under the camera, portals on their borders belong to neighbours too
+        const Rectangle view = camera_view_rect(cam);
+        const float clusterSize = float(ts) * tile_size;
+        const size_t fromX = size_t(std::clamp(int(floorf(view.x / clusterSize)) - 1, 0, int(wd) - 1));
+        const size_t fromY = size_t(std::clamp(int(floorf(view.y / clusterSize)) - 1, 0, int(hd) - 1));
+        const size_t toX = size_t(std::clamp(int(floorf((view.x + view.width) / clusterSize)) + 1, 0, int(wd) - 1));
+        const size_t toY = size_t(std::clamp(int(floorf((view.y + view.height) / clusterSize)) + 1, 0, int(hd) - 1));
+
+        for (size_t y = fromY; y <= toY; ++y)
+          DrawLineEx(Vector2{0.f, float(y) * clusterSize},
+                     Vector2{float(dd.width) * tile_size, float(y) * clusterSize}, 1.f, GetColor(0xff000080));
+        for (size_t x = fromX; x <= toX; ++x)
+          DrawLineEx(Vector2{float(x) * clusterSize, 0.f},
+                     Vector2{float(x) * clusterSize, float(dd.height) * tile_size}, 1.f, GetColor(0xff000080));
+
         Vector2 mousePosition = GetScreenToWorld2D(GetMousePosition(), cam);
-        size_t wd = w / ts;
-        for (size_t y = 0; y < dd.height / ts; ++y)
-        {
-          if (mousePosition.y < y * ts * tile_size || mousePosition.y > (y + 1) * ts * tile_size)
-            continue;
-          for (size_t x = 0; x < dd.width / ts; ++x)
+        static std::vector<size_t> visiblePortals;
+        visiblePortals.clear();
+        for (size_t y = fromY; y <= toY; ++y)
+          for (size_t x = fromX; x <= toX; ++x)
           {
-            if (mousePosition.x < x * ts * tile_size || mousePosition.x > (x + 1) * ts * tile_size)
+            const std::vector<size_t> &clusterPortals = dp.tilePortalsIndices[y * wd + x];
+            visiblePortals.insert(visiblePortals.end(), clusterPortals.begin(), clusterPortals.end());
+            if (mousePosition.x < float(x) * clusterSize || mousePosition.x > float(x + 1) * clusterSize ||
+                mousePosition.y < float(y) * clusterSize || mousePosition.y > float(y + 1) * clusterSize)
               continue;
-            for (size_t idx : dp.tilePortalsIndices[y * wd + x])
+            for (size_t idx : clusterPortals)
             {
               const PathPortal &portal = dp.portals[idx];
               Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
@@ -111,9 +156,12 @@ static void register_roguelike_systems(flecs::world &ecs)
               DrawRectangleLinesEx(rect, 3, BLACK);
             }
           }
-        }
-        for (const PathPortal &portal : dp.portals)
+        std::sort(visiblePortals.begin(), visiblePortals.end());
+        visiblePortals.erase(std::unique(visiblePortals.begin(), visiblePortals.end()), visiblePortals.end());
+
+        for (size_t idx : visiblePortals)
         {
+          const PathPortal &portal = dp.portals[idx];
           Rectangle rect{portal.startX * tile_size, portal.startY * tile_size,
                          (portal.endX - portal.startX + 1) * tile_size,
                          (portal.endY - portal.startY + 1) * tile_size};
@@ -138,6 +186,23 @@ static void register_roguelike_systems(flecs::world &ecs)
       });
     });
   steer::register_systems(ecs);
+
+  // everyone with hitpoints is in the spatial hash, which is rebuilt after movement,
+  // so only actors under the camera are visited. Positions are top left corners of sprites.
+  ecs.system<const SpatialHash>()
+    .each([&](const SpatialHash &sh)
+    {
+      cameraQuery.each([&](const Camera2D &cam)
+      {
+        const Rectangle view = camera_view_rect(cam);
+        sh.queryRect(Position{view.x - tile_size, view.y - tile_size},
+                     Position{view.x + view.width, view.y + view.height},
+                     [&](const SpatialHash::Entry &entry)
+        {
+          entry.entity.get([&](const Color &color) { draw_sprite(entry.entity, entry.pos, color); });
+        });
+      });
+    });
 }
 
 
@@ -150,38 +215,36 @@ void init_shoot_em_up(flecs::world &ecs)
   ecs.entity("minotaur_tex")
     .set(Texture2D{LoadTexture("assets/minotaur.png")});
 
+  const Color colors[steer::Type::Num] = {WHITE, RED, BLUE, GREEN};
+  for (int st = 0; st < steer::Type::Num; ++st)
+    steer::create_steer_prefab(create_monster_prefab(ecs, monster_prefabs[st], colors[st], "minotaur_tex"),
+                               steer::Type(st));
+
   const Position walkableTile = dungeon::find_walkable_tile(ecs);
   create_player(ecs, walkableTile * tile_size, "swordsman_tex");
 }
 
 void init_dungeon(flecs::world &ecs, char *tiles, size_t w, size_t h)
 {
-  flecs::entity wallTex = ecs.entity("wall_tex")
-    .set(Texture2D{LoadTexture("assets/wall.png")});
-  flecs::entity floorTex = ecs.entity("floor_tex")
-    .set(Texture2D{LoadTexture("assets/floor.png")});
+  const Texture2D wallTex = LoadTexture("assets/wall.png");
+  const Texture2D floorTex = LoadTexture("assets/floor.png");
+  ecs.entity("wall_tex")
+    .set(Texture2D{wallTex});
+  ecs.entity("floor_tex")
+    .set(Texture2D{floorTex});
 
   std::vector<char> dungeonData;
   dungeonData.resize(w * h);
   for (size_t y = 0; y < h; ++y)
     for (size_t x = 0; x < w; ++x)
       dungeonData[y * w + x] = tiles[y * w + x];
+  DungeonData dd{dungeonData, w, h};
   ecs.entity("dungeon")
-    .set(DungeonData{dungeonData, w, h});
+    .set(build_wall_distance_field(dd, tile_size))
+    .set(create_flow_field(tile_size))
+    .set(build_tile_map(dd, tile_size, wallTex, floorTex))
+    .set(std::move(dd));
 
-  for (size_t y = 0; y < h; ++y)
-    for (size_t x = 0; x < w; ++x)
-    {
-      char tile = tiles[y * w + x];
-      flecs::entity tileEntity = ecs.entity()
-        .add<BackgroundTile>()
-        .set(Position{float(x) * tile_size, float(y) * tile_size})
-        .set(Color{255, 255, 255, 255});
-      if (tile == dungeon::wall)
-        tileEntity.add<TextureSource>(wallTex);
-      else if (tile == dungeon::floor)
-        tileEntity.add<TextureSource>(floorTex);
-    }
   prebuild_map(ecs);
 }
 
@@ -0,0 +1,31 @@
+#include "spatialHash.h"
+
+void SpatialHash::clear()
+{
+  entries.clear();
+}
+
+void SpatialHash::add(flecs::entity e, const Position &pos, const Velocity &vel)
+{
+  entries.push_back(Entry{e, pos, vel, cellCoord(pos.x), cellCoord(pos.y)});
+}
+
+void SpatialHash::build()
+{
+  // power of two buckets, about two per entry
+  size_t numBuckets = 1;
+  while (numBuckets < entries.size() * 2)
+    numBuckets <<= 1;
+  bucketMask = uint32_t(numBuckets - 1);
+  bucketStart.assign(numBuckets + 2, 0u);
+
+  // counting sort by bucket, bucketStart is used as a counter first
+  for (const Entry &entry : entries)
+    bucketStart[bucketOf(entry.cellX, entry.cellY) + 2]++;
+  for (size_t i = 2; i < bucketStart.size(); ++i)
+    bucketStart[i] += bucketStart[i - 1];
+  scratch.resize(entries.size());
+  for (const Entry &entry : entries)
+    scratch[bucketStart[bucketOf(entry.cellX, entry.cellY) + 1]++] = entry;
+  entries.swap(scratch);
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <flecs.h>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include "ecsTypes.h"
+
+// Uniform grid over continuous space, cells are hashed into buckets so world size doesn't matter.
+// Rebuilt from scratch every frame, entries of a bucket are stored contiguously.
+struct SpatialHash
+{
+  struct Entry
+  {
+    flecs::entity entity;
+    Position pos;
+    Velocity vel;
+    int cellX;
+    int cellY;
+  };
+
+  float cellSize = 100.f;
+  std::vector<Entry> entries;
+  std::vector<uint32_t> bucketStart; // bucket i occupies [bucketStart[i], bucketStart[i + 1])
+  uint32_t bucketMask = 0u;
+  std::vector<Entry> scratch;
+
+  int cellCoord(float v) const { return int(floorf(v / cellSize)); }
+  uint32_t bucketOf(int cell_x, int cell_y) const
+  {
+    const uint32_t h = uint32_t(cell_x) * 73856093u ^ uint32_t(cell_y) * 19349663u;
+    return h & bucketMask;
+  }
+
+  void clear();
+  void add(flecs::entity e, const Position &pos, const Velocity &vel);
+  void build();
+
+  // calls c(entry, dist_sq) for everyone within radius of pos
+  template<typename Callable>
+  void query(const Position &pos, float radius, Callable c) const
+  {
+    if (entries.empty())
+      return;
+    const float radiusSq = radius * radius;
+    const int minX = cellCoord(pos.x - radius);
+    const int maxX = cellCoord(pos.x + radius);
+    const int minY = cellCoord(pos.y - radius);
+    const int maxY = cellCoord(pos.y + radius);
+    for (int y = minY; y <= maxY; ++y)
+      for (int x = minX; x <= maxX; ++x)
+      {
+        const uint32_t bucket = bucketOf(x, y);
+        for (uint32_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i)
+        {
+          const Entry &entry = entries[i];
+          if (entry.cellX != x || entry.cellY != y) // other cell hashed into the same bucket
+            continue;
+          const float distSq = length_sq(entry.pos - pos);
+          if (distSq <= radiusSq)
+            c(entry, distSq);
+        }
+      }
+  }
+
+  // calls c(entry) for everyone inside [lo, hi], too large areas fall back to a linear scan
+  template<typename Callable>
+  void queryRect(const Position &lo, const Position &hi, Callable c) const
+  {
+    const int minX = cellCoord(lo.x);
+    const int maxX = cellCoord(hi.x);
+    const int minY = cellCoord(lo.y);
+    const int maxY = cellCoord(hi.y);
+    const auto inside = [&](const Entry &entry)
+    {
+      return entry.pos.x >= lo.x && entry.pos.x <= hi.x && entry.pos.y >= lo.y && entry.pos.y <= hi.y;
+    };
+    if (size_t(maxX - minX + 1) * size_t(maxY - minY + 1) > entries.size())
+    {
+      for (const Entry &entry : entries)
+        if (inside(entry))
+          c(entry);
+      return;
+    }
+    for (int y = minY; y <= maxY; ++y)
+      for (int x = minX; x <= maxX; ++x)
+      {
+        const uint32_t bucket = bucketOf(x, y);
+        for (uint32_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; ++i)
+        {
+          const Entry &entry = entries[i];
+          if (entry.cellX == x && entry.cellY == y && inside(entry))
+            c(entry);
+        }
+      }
+  }
+};
@@ -1,38 +1,39 @@
 #include "steering.h"
 #include "ecsTypes.h"
+#include "spatialHash.h"
+#include "integrator.h"
+#include "wallField.h"
+#include "flowField.h"
+#include "pathFollower.h"
+#include "dungeonUtils.h"
 
 struct Seeker {};
 struct Pursuer {};
 struct Evader {};
 struct Fleer {};
-struct Separation {};
-struct Alignment {};
-struct Cohesion {};
-
 struct SteerAccel { float accel = 1.f; };
 
-static flecs::entity create_separation(flecs::entity e)
+// radius and weight of each flocking behaviour, zero weight turns the behaviour off
+struct Flocking
 {
-  return e.add<Separation>();
-}
+  float separationDist = 70.f;
+  float separationWeight = 1.f;
+  float alignmentDist = 100.f;
+  float alignmentWeight = 0.8f;
+  float cohesionDist = 500.f;
+  float cohesionWeight = 1.f;
+};
 
-static flecs::entity create_alignment(flecs::entity e)
+// pushes away from walls once closer than dist, stronger the deeper it gets
+struct WallAvoidance
 {
-  return e.add<Alignment>();
-}
-
-static flecs::entity create_cohesion(flecs::entity e)
-{
-  return e.add<Cohesion>();
-}
+  float dist = 64.f;
+  float weight = 2.f;
+};
 
 static flecs::entity create_steerer(flecs::entity e)
 {
-  return create_cohesion(
-      create_alignment(
-        create_separation(e.set(SteerDir{0.f, 0.f}).set(SteerAccel{1.f}))
-        )
-      );
+  return e.set(SteerDir{0.f, 0.f}).set(SteerAccel{1.f}).set(Flocking{}).set(WallAvoidance{});
 }
 
 flecs::entity steer::create_seeker(flecs::entity e)
@@ -42,7 +43,7 @@ flecs::entity steer::create_seeker(flecs::entity e)
 
 flecs::entity steer::create_pursuer(flecs::entity e)
 {
-  return create_steerer(e).add<Pursuer>();
+  return create_steerer(e).set(PathFollower{}).add<Pursuer>();
 }
 
 flecs::entity steer::create_evader(flecs::entity e)
@@ -69,132 +70,305 @@ flecs::entity steer::create_steer_beh(flecs::entity e, Type type)
   return steerFoo[type](e);
 }
 
+flecs::entity steer::create_steer_prefab(flecs::entity prefab, Type type)
+{
+  prefab.set_override(SteerDir{0.f, 0.f})
+    .set_override(SteerAccel{1.f})
+    .set_override(Flocking{})
+    .set_override(WallAvoidance{});
+  switch (type)
+  {
+    case StSeeker:
+      return prefab.override<Seeker>();
+    case StPursuer:
+      return prefab.set_override(PathFollower{}).override<Pursuer>();
+    case StEvader:
+      return prefab.override<Evader>();
+    case StFleer:
+      return prefab.override<Fleer>();
+    case Num:
+      break;
+  }
+  return prefab;
+}
+
+void steer::reset_steer_state(flecs::entity e)
+{
+  e.set(SteerDir{0.f, 0.f});
+  e.get([](PathFollower &pf)
+  {
+    if (pf.ticket != 0)
+      path_requests::cancel(pf.ticket);
+    pf.corridor.clear();
+    pf.next = 0;
+    pf.goal = IVec2{-1, -1};
+    pf.ticket = 0;
+  });
+}
+
+
+constexpr int max_path_requests_per_frame = 8;
+constexpr size_t max_path_lookahead = 4;
+
+// walks the line in quarter tile steps
+static bool is_line_walkable(const DungeonData &dd, IVec2 from, IVec2 to)
+{
+  const int steps = std::max(abs(to.x - from.x), abs(to.y - from.y)) * 4;
+  for (int i = 0; i <= steps; ++i)
+  {
+    const float t = steps > 0 ? float(i) / float(steps) : 0.f;
+    const int x = int(floorf(float(from.x) + float(to.x - from.x) * t + 0.5f));
+    const int y = int(floorf(float(from.y) + float(to.y - from.y) * t + 0.5f));
+    if (x < 0 || y < 0 || x >= int(dd.width) || y >= int(dd.height) ||
+        dd.tiles[size_t(y) * dd.width + size_t(x)] == dungeon::wall)
+      return false;
+  }
+  return true;
+}
 
 void steer::register_systems(flecs::world &ecs)
 {
-  static auto playerPosQuery = ecs.query<const Position, const Velocity, const IsPlayer>();
+  // Steering systems below run on worker threads. Everything they read from other entities
+  // is snapshot into steerFrame by a single threaded system first, so they only touch their own row.
+  static struct
+  {
+    bool hasTarget = false;
+    Position targetPos;
+    Velocity targetVel;
+    const SpatialHash *spatialHash = nullptr;
+    const WallDistanceField *wallField = nullptr;
+    const FlowField *flowField = nullptr;
+    const DungeonData *dungeon = nullptr;
+    const DungeonPortals *portals = nullptr;
+    int pathRequests = 0;
+  } steerFrame;
 
+  static_assert(sizeof(SteerAccel) == sizeof(float));
   ecs.system<Velocity, const MoveSpeed, const SteerDir, const SteerAccel>()
-    .each([&](Velocity &vel, const MoveSpeed &ms, const SteerDir &sd, const SteerAccel &sa)
+    .multi_threaded()
+    .iter([&](flecs::iter &it, Velocity *vel, const MoveSpeed *ms, const SteerDir *sd, const SteerAccel *sa)
     {
-      vel = Velocity{truncate(vel + truncate(sd, ms.speed) * ecs.delta_time() * sa.accel, ms.speed)};
+      integrator::integrate_velocity(vel, sd, ms, &sa->accel, it.count(), it.delta_time());
     });
 
   // reset steer dir
-  ecs.system<SteerDir>().each([&](SteerDir &sd) { sd = {0.f, 0.f}; });
+  ecs.system<SteerDir>().multi_threaded().each([&](SteerDir &sd) { sd = {0.f, 0.f}; });
+
+  // neighbours are looked up through spatial hash rebuilt once per frame
+  static auto playerPosQuery = ecs.query<const Position, const Velocity, const IsPlayer>();
+  static auto neighboursQuery = ecs.query<const Position, const Velocity, const Hitpoints>();
+  static auto wallFieldQuery = ecs.query<const WallDistanceField>();
+  static auto portalsQuery = ecs.query<const DungeonPortals>();
+  ecs.entity("steer_spatial_hash")
+    .set(SpatialHash{});
+  ecs.system<SpatialHash>()
+    .each([&](SpatialHash &sh)
+    {
+      sh.clear();
+      neighboursQuery.each([&](flecs::entity e, const Position &p, const Velocity &vel, const Hitpoints &)
+      {
+        sh.add(e, p, vel);
+      });
+      sh.build();
+      steerFrame.spatialHash = &sh;
+
+      steerFrame.hasTarget = false;
+      playerPosQuery.each([&](const Position &pp, const Velocity &pvel, const IsPlayer &)
+      {
+        steerFrame.hasTarget = true;
+        steerFrame.targetPos = pp;
+        steerFrame.targetVel = pvel;
+      });
+
+      steerFrame.wallField = nullptr;
+      wallFieldQuery.each([&](const WallDistanceField &wf) { steerFrame.wallField = &wf; });
+      steerFrame.portals = nullptr;
+      portalsQuery.each([&](const DungeonPortals &dp) { steerFrame.portals = &dp; });
+      steerFrame.pathRequests = 0;
+    });
+
+  // flow field towards the player for seekers and pursuers
+  ecs.system<FlowField, const DungeonData>()
+    .each([&](FlowField &ff, const DungeonData &dd)
+    {
+      if (steerFrame.hasTarget)
+        ff.update(dd, steerFrame.targetPos);
+      steerFrame.flowField = &ff;
+      steerFrame.dungeon = &dd;
+    });
+
+  // picks up finished paths and asks for new ones once the target drifts away from the old goal
+  ecs.system<PathFollower, const Position>()
+    .each([&](PathFollower &pf, const Position &p)
+    {
+      if (pf.ticket != 0 && path_requests::take(pf.ticket, pf.corridor))
+      {
+        pf.ticket = 0;
+        pf.next = 0;
+      }
+      if (pf.ticket != 0 || !steerFrame.hasTarget || !steerFrame.flowField || !steerFrame.dungeon ||
+          !steerFrame.portals)
+        return;
+      const IVec2 targetTile = steerFrame.flowField->tileOf(steerFrame.targetPos);
+      if (pf.goal != IVec2{-1, -1} &&
+          std::max(abs(pf.goal.x - targetTile.x), abs(pf.goal.y - targetTile.y)) <= pf.repathTiles)
+        return;
+      if (steerFrame.pathRequests >= max_path_requests_per_frame)
+        return;
+      steerFrame.pathRequests++;
+      pf.goal = targetTile;
+      pf.ticket = path_requests::request(*steerFrame.dungeon, *steerFrame.portals,
+                                         steerFrame.flowField->tileOf(p), targetTile);
+    });
+
+  // follow the flow field while it has a direction, head straight at target once in its tile
+  static auto flow_direction = [](const Position &p, const Position &target_pos) -> Position
+  {
+    if (steerFrame.flowField)
+    {
+      const Position dir = steerFrame.flowField->direction(p);
+      if (dir != Position{0.f, 0.f})
+        return dir;
+    }
+    return normalize(target_pos - p);
+  };
 
   // seeker
   ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Seeker>()
+    .multi_threaded()
     .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel,
               const Position &p, const Seeker &)
     {
-      playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
-      {
-        sd += SteerDir{normalize(pp - p) * ms.speed - vel};
-      });
+      if (!steerFrame.hasTarget)
+        return;
+      const Position &pp = steerFrame.targetPos;
+      sd += SteerDir{flow_direction(p, pp) * ms.speed - vel};
     });
 
   // fleer
   ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Fleer>()
+    .multi_threaded()
     .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Fleer &)
     {
-      playerPosQuery.each([&](const Position &pp, const Velocity &, const IsPlayer &)
-      {
-        sd += SteerDir{normalize(p - pp) * ms.speed - vel};
-      });
+      if (!steerFrame.hasTarget)
+        return;
+      const Position &pp = steerFrame.targetPos;
+      sd += SteerDir{normalize(p - pp) * ms.speed - vel};
     });
 
-  // pursuer
-  ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Pursuer>()
-    .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Pursuer &)
+  // pursuer, goes along its corridor and finishes the last leg with the flow field
+  ecs.system<SteerDir, PathFollower, const MoveSpeed, const Velocity, const Position, const Pursuer>()
+    .multi_threaded()
+    .each([&](SteerDir &sd, PathFollower &pf, const MoveSpeed &ms, const Velocity &vel, const Position &p,
+              const Pursuer &)
     {
-      playerPosQuery.each([&](const Position &pp, const Velocity &pvel, const IsPlayer &)
+      if (!steerFrame.hasTarget)
+        return;
+      const Position &pp = steerFrame.targetPos;
+      const Velocity &pvel = steerFrame.targetVel;
+      constexpr float predictTime = 4.f;
+      const Position targetPos = pp + pvel * predictTime;
+      if (steerFrame.flowField && steerFrame.dungeon && pf.next + 1 < pf.corridor.size())
       {
-        constexpr float predictTime = 4.f;
-        const Position targetPos = pp + pvel * predictTime;
-        sd += SteerDir{normalize(targetPos - p) * ms.speed - vel};
-      });
+        const FlowField &ff = *steerFrame.flowField;
+        const IVec2 tile = ff.tileOf(p);
+        // string pulling, skip waypoints which are already in straight walkable line
+        if (tile == pf.corridor[pf.next])
+          pf.next++;
+        for (size_t i = 0; i < max_path_lookahead && pf.next + 1 < pf.corridor.size() &&
+                           is_line_walkable(*steerFrame.dungeon, tile, pf.corridor[pf.next + 1]); ++i)
+          pf.next++;
+        if (pf.next + 1 < pf.corridor.size())
+        {
+          const IVec2 wp = pf.corridor[pf.next];
+          const Position wpPos{float(wp.x) * ff.tileSize, float(wp.y) * ff.tileSize};
+          sd += SteerDir{normalize(wpPos - p) * ms.speed - vel};
+          return;
+        }
+      }
+      sd += SteerDir{flow_direction(p, targetPos) * ms.speed - vel};
     });
 
   // evader
   ecs.system<SteerDir, const MoveSpeed, const Velocity, const Position, const Evader>()
+    .multi_threaded()
     .each([&](SteerDir &sd, const MoveSpeed &ms, const Velocity &vel, const Position &p, const Evader &)
     {
-      playerPosQuery.each([&](const Position &pp, const Velocity &pvel,
-                              const IsPlayer &)
-      {
-        constexpr float maxPredictTime = 4.f;
-        const Position dpos = p - pp;
-        const float dist = length(dpos);
-        const Position dvel = vel - pvel;
-        const float dotProduct = (dvel.x * dpos.x + dvel.y * dpos.y) * safeinv(dist);
-        const float interceptTime = dotProduct * safeinv(length(dvel));
-        const float predictTime = std::max(std::min(maxPredictTime, interceptTime * 0.9f), 1.f);
-
-        const Position targetPos = pp + pvel * predictTime;
-        sd += SteerDir{normalize(p - targetPos) * ms.speed - vel};
-      });
-    });
-
-  static auto otherPosQuery = ecs.query<const Position, const Hitpoints>();
+      if (!steerFrame.hasTarget)
+        return;
+      const Position &pp = steerFrame.targetPos;
+      const Velocity &pvel = steerFrame.targetVel;
+      constexpr float maxPredictTime = 4.f;
+      const Position dpos = p - pp;
+      const float dist = length(dpos);
+      const Position dvel = vel - pvel;
+      const float dotProduct = (dvel.x * dpos.x + dvel.y * dpos.y) * safeinv(dist);
+      const float interceptTime = dotProduct * safeinv(length(dvel));
+      const float predictTime = std::max(std::min(maxPredictTime, interceptTime * 0.9f), 1.f);
 
-  // separation is expensive!!!
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Separation>()
-    .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Separation &)
-    {
-      otherPosQuery.each([&](flecs::entity oe, const Position &op, const Hitpoints &)
-      {
-        if (oe == ent)
-          return;
-        constexpr float thresDist = 70.f;
-        constexpr float thresDistSq = thresDist * thresDist;
-        const float distSq = length_sq(op - p);
-        if (distSq > thresDistSq)
-          return;
-        sd += SteerDir{(p - op) * safeinv(distSq) * ms.speed * thresDist - vel};
-      });
+      const Position targetPos = pp + pvel * predictTime;
+      sd += SteerDir{normalize(p - targetPos) * ms.speed - vel};
     });
 
-  static auto otherVelQuery = ecs.query<const Position, const Velocity>();
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Alignment>()
+  // separation, alignment and cohesion gathered in a single pass over neighbours
+  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Flocking>()
+    .multi_threaded()
     .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Alignment &)
+              const Position &p, const Flocking &fl)
     {
-      otherVelQuery.each([&](flecs::entity oe, const Position &op, const Velocity &ovel)
-      {
-        if (oe == ent)
-          return;
-        constexpr float thresDist = 100.f;
-        constexpr float thresDistSq = thresDist * thresDist;
-        const float distSq = length_sq(op - p);
-        if (distSq > thresDistSq)
-          return;
-        sd += SteerDir{ovel * 0.8f};
-      });
-    });
+      const float separationDist = fl.separationWeight > 0.f ? fl.separationDist : 0.f;
+      const float alignmentDist = fl.alignmentWeight > 0.f ? fl.alignmentDist : 0.f;
+      const float cohesionDist = fl.cohesionWeight > 0.f ? fl.cohesionDist : 0.f;
+      const float queryDist = std::max(separationDist, std::max(alignmentDist, cohesionDist));
+      if (queryDist <= 0.f || !steerFrame.spatialHash)
+        return;
+      const float separationDistSq = separationDist * separationDist;
+      const float alignmentDistSq = alignmentDist * alignmentDist;
+      const float cohesionDistSq = cohesionDist * cohesionDist;
 
-  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const Cohesion>()
-    .each([&](flecs::entity ent, SteerDir &sd, const Velocity &vel, const MoveSpeed &ms,
-              const Position &p, const Cohesion &)
-    {
-      Position avgPos{0.f, 0.f};
+      Position separation{0.f, 0.f};
+      Position velSum{0.f, 0.f};
+      Position posSum{0.f, 0.f};
       size_t count = 0;
-      otherPosQuery.each([&](flecs::entity oe, const Position &op, const Hitpoints &)
+      steerFrame.spatialHash->query(p, queryDist, [&](const SpatialHash::Entry &other, float distSq)
       {
-        if (oe == ent)
+        if (other.entity == ent)
           return;
-        constexpr float thresDist = 500.f;
-        constexpr float thresDistSq = thresDist * thresDist;
-        const float distSq = length_sq(op - p);
-        if (distSq > thresDistSq)
-          return;
-        count++;
-        avgPos += op;
+        if (distSq <= separationDistSq)
+          separation += (p - other.pos) * safeinv(distSq) * ms.speed * separationDist - vel;
+        if (distSq <= alignmentDistSq)
+          velSum += other.vel;
+        if (distSq <= cohesionDistSq)
+        {
+          count++;
+          posSum += other.pos;
+        }
       });
-      constexpr float avgPosMult = 100.f;
-      sd += SteerDir{normalize(avgPos * safeinv(float(count)) - p) * avgPosMult - vel};
+      Position steer = separation * fl.separationWeight + velSum * fl.alignmentWeight;
+      if (fl.cohesionWeight > 0.f)
+      {
+        constexpr float avgPosMult = 100.f;
+        steer += (normalize(posSum * safeinv(float(count)) - p) * avgPosMult - vel) * fl.cohesionWeight;
+      }
+      sd += SteerDir{steer};
     });
 
+  // wall avoidance and containment
+  ecs.system<SteerDir, const Velocity, const MoveSpeed, const Position, const WallAvoidance>()
+    .multi_threaded()
+    .each([&](SteerDir &sd, const Velocity &vel, const MoveSpeed &ms, const Position &p, const WallAvoidance &wa)
+    {
+      if (!steerFrame.wallField)
+        return;
+      Position grad;
+      const float dist = steerFrame.wallField->sample(p, grad);
+      if (dist >= wa.dist)
+        return;
+      const Position away = normalize(grad);
+      // cancel the part of velocity going into the wall and push out, harder when inside
+      const float intoWall = std::min(vel.x * away.x + vel.y * away.y, 0.f);
+      const float strength = std::min((wa.dist - dist) / wa.dist, 2.f) * wa.weight;
+      sd += SteerDir{away * (ms.speed * strength - intoWall)};
+    });
 }
 
@@ -13,6 +13,10 @@ namespace steer
   };
 
   flecs::entity create_steer_beh(flecs::entity e, Type type);
+  // same components as create_steer_beh, overridden so prefab instances own them
+  flecs::entity create_steer_prefab(flecs::entity prefab, Type type);
+  // clears per agent steering state of a reused entity
+  void reset_steer_state(flecs::entity e);
 
   flecs::entity create_seeker(flecs::entity e);
   flecs::entity create_pursuer(flecs::entity e);
@@ -0,0 +1,80 @@
+#include "tileMap.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cmath>
+
+static bool overlaps(const Rectangle &lhs, const Rectangle &rhs)
+{
+  return lhs.x < rhs.x + rhs.width && rhs.x < lhs.x + lhs.width &&
+         lhs.y < rhs.y + rhs.height && rhs.y < lhs.y + lhs.height;
+}
+
+TileMap build_tile_map(const DungeonData &dd, float tile_size, Texture2D wall_tex, Texture2D floor_tex)
+{
+  TileMap res;
+  res.tileSize = tile_size;
+  res.chunksWidth = (dd.width + tile_map_chunk_size - 1) / tile_map_chunk_size;
+  res.chunksHeight = (dd.height + tile_map_chunk_size - 1) / tile_map_chunk_size;
+  res.textures[TK_WALL] = wall_tex;
+  res.textures[TK_FLOOR] = floor_tex;
+  res.chunks.resize(res.chunksWidth * res.chunksHeight);
+
+  const float chunkSize = float(tile_map_chunk_size) * tile_size;
+  for (size_t cy = 0; cy < res.chunksHeight; ++cy)
+    for (size_t cx = 0; cx < res.chunksWidth; ++cx)
+      res.chunks[cy * res.chunksWidth + cx].bounds = Rectangle{float(cx) * chunkSize, float(cy) * chunkSize, chunkSize, chunkSize};
+
+  for (size_t y = 0; y < dd.height; ++y)
+    for (size_t x = 0; x < dd.width; ++x)
+    {
+      const char tile = dd.tiles[y * dd.width + x];
+      TileMapChunk &chunk = res.chunks[(y / tile_map_chunk_size) * res.chunksWidth + x / tile_map_chunk_size];
+      const Vector2 corner{float(x) * tile_size, float(y) * tile_size};
+      if (tile == dungeon::wall)
+        chunk.tiles[TK_WALL].push_back(corner);
+      else if (tile == dungeon::floor)
+        chunk.tiles[TK_FLOOR].push_back(corner);
+    }
+  return res;
+}
+
+void TileMap::draw(const Rectangle &view) const
+{
+  if (chunks.empty())
+    return;
+  const float chunkSize = float(tile_map_chunk_size) * tileSize;
+  // only chunks under the view are visited at all
+  const int fromX = std::max(int(floorf(view.x / chunkSize)), 0);
+  const int fromY = std::max(int(floorf(view.y / chunkSize)), 0);
+  const int toX = std::min(int(floorf((view.x + view.width) / chunkSize)), int(chunksWidth) - 1);
+  const int toY = std::min(int(floorf((view.y + view.height) / chunkSize)), int(chunksHeight) - 1);
+  for (int kind = 0; kind < TK_NUM; ++kind)
+    for (int cy = fromY; cy <= toY; ++cy)
+      for (int cx = fromX; cx <= toX; ++cx)
+      {
+        const TileMapChunk &chunk = chunks[size_t(cy) * chunksWidth + size_t(cx)];
+        if (!overlaps(chunk.bounds, view))
+          continue;
+        for (const Vector2 &corner : chunk.tiles[kind])
+          DrawTextureQuad(textures[kind], Vector2{1, 1}, Vector2{0, 0},
+                          Rectangle{corner.x, corner.y, tileSize, tileSize}, WHITE);
+      }
+}
+
+Rectangle camera_view_rect(const Camera2D &cam)
+{
+  const float w = float(GetScreenWidth());
+  const float h = float(GetScreenHeight());
+  const Vector2 corners[4] = {GetScreenToWorld2D(Vector2{0.f, 0.f}, cam), GetScreenToWorld2D(Vector2{w, 0.f}, cam),
+                              GetScreenToWorld2D(Vector2{0.f, h}, cam), GetScreenToWorld2D(Vector2{w, h}, cam)};
+  Vector2 lo = corners[0];
+  Vector2 hi = corners[0];
+  for (const Vector2 &c : corners)
+  {
+    lo.x = std::min(lo.x, c.x);
+    lo.y = std::min(lo.y, c.y);
+    hi.x = std::max(hi.x, c.x);
+    hi.y = std::max(hi.y, c.y);
+  }
+  return Rectangle{lo.x, lo.y, hi.x - lo.x, hi.y - lo.y};
+}
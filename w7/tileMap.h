@@ -0,0 +1,38 @@
+#pragma once
+#include <raylib.h>
+#include <vector>
+#include "ecsTypes.h"
+
+constexpr size_t tile_map_chunk_size = 16; // in tiles
+
+enum TileKind
+{
+  TK_WALL = 0,
+  TK_FLOOR,
+  TK_NUM
+};
+
+// Static dungeon tiles split in square chunks. Every chunk keeps its tile corners grouped
+// by texture, so a visible chunk turns into a batch per texture and hidden ones cost nothing.
+struct TileMapChunk
+{
+  Rectangle bounds;
+  std::vector<Vector2> tiles[TK_NUM];
+};
+
+struct TileMap
+{
+  float tileSize = 0.f;
+  size_t chunksWidth = 0;
+  size_t chunksHeight = 0;
+  Texture2D textures[TK_NUM] = {};
+  std::vector<TileMapChunk> chunks;
+
+  // view is a world space rect
+  void draw(const Rectangle &view) const;
+};
+
+TileMap build_tile_map(const DungeonData &dd, float tile_size, Texture2D wall_tex, Texture2D floor_tex);
+
+// world space rect seen by the camera
+Rectangle camera_view_rect(const Camera2D &cam);
@@ -0,0 +1,98 @@
+#include "wallField.h"
+#include "dungeonUtils.h"
+#include <algorithm>
+#include <cmath>
+
+// distances are exact up to this many tiles away from a wall, clamped after
+constexpr int max_search_tiles = 3;
+
+static bool is_wall(const DungeonData &dd, int x, int y)
+{
+  if (x < 0 || y < 0 || x >= int(dd.width) || y >= int(dd.height))
+    return true;
+  return dd.tiles[size_t(y) * dd.width + size_t(x)] == dungeon::wall;
+}
+
+static float dist_to_tile(float px, float py, int x, int y, float tile_size)
+{
+  const float x0 = float(x) * tile_size;
+  const float y0 = float(y) * tile_size;
+  const float dx = std::max(std::max(x0 - px, px - x0 - tile_size), 0.f);
+  const float dy = std::max(std::max(y0 - py, py - y0 - tile_size), 0.f);
+  return sqrtf(dx * dx + dy * dy);
+}
+
+WallDistanceField build_wall_distance_field(const DungeonData &dd, float tile_size)
+{
+  WallDistanceField res;
+  res.cellSize = tile_size * 0.5f;
+  res.centerOffset = tile_size * 0.5f;
+  res.width = dd.width * 2 + 1;
+  res.height = dd.height * 2 + 1;
+  res.dist.resize(res.width * res.height);
+  res.grad.resize(res.width * res.height);
+
+  const float maxDist = float(max_search_tiles) * tile_size;
+  for (size_t sy = 0; sy < res.height; ++sy)
+    for (size_t sx = 0; sx < res.width; ++sx)
+    {
+      const float px = float(sx) * res.cellSize;
+      const float py = float(sy) * res.cellSize;
+      const int tx = int(sx / 2);
+      const int ty = int(sy / 2);
+      // samples on tile edges and corners are inside only if every tile they touch is a wall
+      const int fromX = sx % 2 == 0 ? tx - 1 : tx;
+      const int fromY = sy % 2 == 0 ? ty - 1 : ty;
+      bool inside = true;
+      for (int y = fromY; y <= ty; ++y)
+        for (int x = fromX; x <= tx; ++x)
+          inside = inside && is_wall(dd, x, y);
+      // distance to the closest wall box when outside, to the closest floor box when inside
+      float d = maxDist;
+      for (int y = ty - max_search_tiles; y <= ty + max_search_tiles; ++y)
+        for (int x = tx - max_search_tiles; x <= tx + max_search_tiles; ++x)
+          if (is_wall(dd, x, y) != inside)
+            d = std::min(d, dist_to_tile(px, py, x, y, tile_size));
+      res.dist[sy * res.width + sx] = inside ? -d : d;
+    }
+
+  // samples on the map border touch outer walls, so outward is always downhill
+  for (size_t sy = 0; sy < res.height; ++sy)
+    for (size_t sx = 0; sx < res.width; ++sx)
+    {
+      const size_t x0 = sx > 0 ? sx - 1 : sx;
+      const size_t x1 = sx + 1 < res.width ? sx + 1 : sx;
+      const size_t y0 = sy > 0 ? sy - 1 : sy;
+      const size_t y1 = sy + 1 < res.height ? sy + 1 : sy;
+      const float gx = (res.dist[sy * res.width + x1] - res.dist[sy * res.width + x0]) / (float(x1 - x0) * res.cellSize);
+      const float gy = (res.dist[y1 * res.width + sx] - res.dist[y0 * res.width + sx]) / (float(y1 - y0) * res.cellSize);
+      res.grad[sy * res.width + sx] = Position{gx, gy};
+    }
+  return res;
+}
+
+float WallDistanceField::sample(const Position &pos, Position &grad_out) const
+{
+  if (dist.empty())
+  {
+    grad_out = Position{0.f, 0.f};
+    return 0.f;
+  }
+  const float fx = std::clamp((pos.x + centerOffset) / cellSize, 0.f, float(width - 1));
+  const float fy = std::clamp((pos.y + centerOffset) / cellSize, 0.f, float(height - 1));
+  const size_t x0 = std::min(size_t(fx), width - 2);
+  const size_t y0 = std::min(size_t(fy), height - 2);
+  const float tx = fx - float(x0);
+  const float ty = fy - float(y0);
+
+  const size_t i00 = y0 * width + x0;
+  const size_t i10 = i00 + 1;
+  const size_t i01 = i00 + width;
+  const size_t i11 = i01 + 1;
+  const float w00 = (1.f - tx) * (1.f - ty);
+  const float w10 = tx * (1.f - ty);
+  const float w01 = (1.f - tx) * ty;
+  const float w11 = tx * ty;
+  grad_out = grad[i00] * w00 + grad[i10] * w10 + grad[i01] * w01 + grad[i11] * w11;
+  return dist[i00] * w00 + dist[i10] * w10 + dist[i01] * w01 + dist[i11] * w11;
+}
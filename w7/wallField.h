@@ -0,0 +1,21 @@
+#pragma once
+#include <vector>
+#include "ecsTypes.h"
+
+// Signed distance to the closest wall sampled every half a tile, negative inside walls
+// and outside of the map. Built once from DungeonData, lookups are bilinear.
+// Positions are top left corners of sprites, so lookups are shifted to the sprite center.
+struct WallDistanceField
+{
+  float cellSize = 0.f;
+  float centerOffset = 0.f;
+  size_t width = 0;
+  size_t height = 0;
+  std::vector<float> dist;
+  std::vector<Position> grad; // points away from walls, not normalized
+
+  // returns distance at pos, gradient is written to grad_out
+  float sample(const Position &pos, Position &grad_out) const;
+};
+
+WallDistanceField build_wall_distance_field(const DungeonData &dd, float tile_size);